@@ -1,15 +1,29 @@
+#pragma once
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <new>
+#include <stdexcept>
 #include <vector>
 
 #include "bamboofilter/predefine.h"
 #include "bamboofilter/segment.hpp"
+#include "bamboofilter/short_segment.hpp"
 #include "common/BOBHash.h"
 
+// Filter users that do not record latencies stay clear of the histogram code.
+#ifdef ENABLE_LATENCY_HISTOGRAM
+#include "common/latency.h"
+#else
+#define LATENCY_START()
+#define LATENCY_RECORD(event)
+#endif
+
 using std::vector;
 
 class BambooFilter
@@ -19,52 +33,266 @@ public:
     uint32_t num_table_bits_;
 
     vector<Segment *> hash_table_;
+    // Where the segments keep their chains; NULL for the heap.
+    SegmentArena *const arena_;
+
+    // Memory budget (see SetMemoryBudget). Past it the table is rebuilt once in
+    // short_table_ with 8-bit tags, holding bits [tag_shift_, tag_shift_ + 8) of
+    // the 12-bit tag, and hash_table_ is left empty.
+    uint64_t max_bytes_;
+    bool short_tags_;
+    uint32_t tag_shift_;
+    vector<ShortTagSegment *> short_table_;
+
+    uint64_t split_condition_;
+
+    uint64_t next_split_idx_;
+    uint64_t num_items_;
+
+    // Sum of chain_capacity over all segments, i.e. the table's size in buckets
+    // per chain; 2 * sum_capacity_ / segments is the average lookup cost.
+    uint64_t sum_capacity_;
+    // Sum of SizeInBytes over all segments, so the memory budget costs O(1).
+    uint64_t segment_bytes_;
+    // Chain-length growth policy (see SetChainBudget); off while max_avg_scan_ is 0.
+    double max_avg_scan_;
+    uint32_t max_chain_capacity_;
+
+    inline uint64_t NumSegments() const
+    {
+        return short_tags_ ? short_table_.size() : hash_table_.size();
+    }
 
-    uint32_t split_condition_;
+    inline bool OverChainBudget(uint32_t chain_capacity) const
+    {
+        return 2.0 * sum_capacity_ > max_avg_scan_ * NumSegments() ||
+               (max_chain_capacity_ && chain_capacity > max_chain_capacity_);
+    }
+
+    // Compress only if the merged table scans at most half the budget on average
+    // even when perfectly packed, so inserts and deletes near the threshold do not
+    // split and merge the same pair over and over.
+    inline bool UnderChainBudget() const
+    {
+        const uint64_t initial_segments = 1ULL << (INIT_TABLE_BITS - BUCKETS_PER_SEG);
+        const uint64_t slots = (NumSegments() - 1) * (1ULL << BUCKETS_PER_SEG) * 4;
+        return NumSegments() > initial_segments && 2.0 * num_items_ / slots <= max_avg_scan_ / 2;
+    }
 
-    uint32_t next_split_idx_;
-    uint32_t num_items_;
+    // Item-count policy: Compress once every split_condition_ + 1 deletes, but
+    // only while the table has at least the segments its items call for (and
+    // more than it started with). It can have fewer when over-budget inserts
+    // were rejected or splits ran out of tag bits.
+    inline bool CompressDue() const
+    {
+        return MergeDue(num_items_, split_condition_, NumSegments(), INIT_TABLE_BITS);
+    }
 
-    inline uint32_t BucketIndexHash(uint32_t index) const
+    // Linear hashing over a table of segments, shared with BambooMap. SegmentT
+    // needs a copy constructor, EraseEle and an Absorb that allocates before it
+    // changes anything.
+    //
+    // Splits table[next_split_idx] into itself and a copy appended to the
+    // table; each keeps the tags whose next bit (counted above tag_shift) is 0
+    // or 1. Returns the copy.
+    template <class SegmentT>
+    static SegmentT *SplitSegment(vector<SegmentT *> &table, uint32_t init_table_bits, uint32_t tag_shift,
+                                  uint32_t &num_table_bits, uint64_t &next_split_idx);
+
+    // The segment the last one merges back into.
+    static inline uint64_t MergeTarget(uint64_t num_segments, uint64_t next_split_idx)
     {
-        return index & ((1 << BUCKETS_PER_SEG) - 1);
+        const uint32_t num_seg_bits = (uint32_t)ceil(log2((double)(num_segments - 1)));
+        return (next_split_idx ? next_split_idx : (1ULL << (num_seg_bits - 1))) - 1;
     }
 
-    inline uint32_t SegIndexHash(uint32_t index) const
+    // Undoes the last split and returns the merged segment. If Absorb throws,
+    // the table is unchanged.
+    template <class SegmentT>
+    static SegmentT *MergeSegment(vector<SegmentT *> &table, uint32_t &num_table_bits, uint64_t &next_split_idx);
+
+    // Whether the next split has a tag bit left below tag_bits to sort on.
+    static inline bool CanSplit(uint64_t num_segments, uint32_t init_table_bits, uint32_t tag_bits)
     {
-        return index & ((1 << NUM_SEG_BITS) - 1);
+        const uint32_t next_table_bits = (uint32_t)ceil(log2((double)(num_segments + 1))) + BUCKETS_PER_SEG;
+        return next_table_bits - init_table_bits - 1 < tag_bits;
     }
 
-    inline uint32_t TagHash(uint32_t tag) const
+    // Whether a delete that left num_items should merge under the item-count
+    // policy (see CompressDue).
+    static inline bool MergeDue(uint64_t num_items, uint64_t split_condition, uint64_t num_segments,
+                                uint32_t init_table_bits)
     {
-        return tag & FINGUREPRINT_MASK;
+        const uint64_t initial_segments = 1ULL << (init_table_bits - BUCKETS_PER_SEG);
+        return !(num_items & split_condition) && num_segments > initial_segments &&
+               num_segments >= initial_segments + num_items / (split_condition + 1);
     }
 
-    inline void GenerateIndexTagHash(const char *item, uint32_t &seg_index, uint32_t &bucket_index, uint32_t &tag) const
+    // 64-bit hash: bucket bits, then segment bits, then the tag. The tag stays
+    // independent of the index bits as long as INIT_TABLE_BITS + BITS_PER_TAG <= 64.
+    // Static so that readers holding only the table geometry (a shared-memory view,
+    // a set of filters probed with one hash) derive exactly the same positions.
+    static inline void IndexTagFromHash(uint64_t hash, uint32_t init_table_bits, uint32_t num_table_bits,
+                                        uint64_t num_segments, uint64_t &seg_index, uint32_t &bucket_index, uint32_t &tag)
     {
-        const uint32_t hash = BOBHash::run(item, strlen(item), 3);
+        const uint32_t num_seg_bits = num_table_bits - BUCKETS_PER_SEG;
 
-        bucket_index = BucketIndexHash(hash);
-        seg_index = SegIndexHash(hash >> BUCKETS_PER_SEG);
-        tag = TagHash(hash >> INIT_TABLE_BITS);
+        bucket_index = hash & ((1ULL << BUCKETS_PER_SEG) - 1);
+        seg_index = (hash >> BUCKETS_PER_SEG) & ((1ULL << num_seg_bits) - 1);
+        tag = (hash >> init_table_bits) & FINGUREPRINT_MASK;
 
         if (!(tag))
         {
-            if (num_table_bits_ > INIT_TABLE_BITS)
+            if (num_table_bits > init_table_bits)
+            {
+                seg_index |= (1ULL << (init_table_bits - BUCKETS_PER_SEG));
+            }
+            tag++;
+        }
+
+        if (seg_index >= num_segments)
+        {
+            seg_index = seg_index - (1ULL << (num_seg_bits - 1));
+        }
+    }
+
+    // Shortened tags can no longer give the alternate chain they had, and two
+    // keys with the same short tag must have either the same pair of chains or
+    // disjoint pairs, or a Delete could remove another key's tag. So a short tag
+    // lives in a home chain, one of its two 12-bit candidates. The home is the
+    // same from either candidate, and each is picked about half the time.
+    // Its alternate chain then follows from the short tag alone
+    // (ShortTagSegment::AltIndex).
+    static inline uint32_t ShortTagHome(uint32_t chain_idx, uint32_t tag)
+    {
+        const uint32_t chain_mask = (1U << BUCKETS_PER_SEG) - 1;
+        const uint32_t d = tag & chain_mask;
+        if (!d)
+        {
+            return chain_idx;
+        }
+        // parity((c ^ r) & m) differs between c and c ^ d as long as d & m has odd parity
+        const uint32_t h = tag * 0x9E3779B1U;
+        uint32_t m = (h >> 12) & chain_mask;
+        if (!__builtin_parity(d & m))
+        {
+            m ^= d & -d;
+        }
+        const uint32_t r = (h >> 22) & chain_mask;
+        return __builtin_parity((chain_idx ^ r) & m) ? chain_idx ^ d : chain_idx;
+    }
+
+    // IndexTagFromHash for a short-tag table. A zero short tag is stored as 1
+    // and sent to the segment selected when its bit 0 (bit tag_shift of the
+    // 12-bit tag) is 1, the same way a zero 12-bit tag is handled.
+    static inline void ShortIndexTagFromHash(uint64_t hash, uint32_t init_table_bits, uint32_t num_table_bits,
+                                             uint64_t num_segments, uint32_t tag_shift, uint64_t &seg_index,
+                                             uint32_t &chain_idx, uint32_t &alt_idx, uint8_t &short_tag)
+    {
+        const uint32_t num_seg_bits = num_table_bits - BUCKETS_PER_SEG;
+
+        const uint32_t bucket_index = hash & ((1ULL << BUCKETS_PER_SEG) - 1);
+        seg_index = (hash >> BUCKETS_PER_SEG) & ((1ULL << num_seg_bits) - 1);
+        uint32_t tag = (hash >> init_table_bits) & FINGUREPRINT_MASK;
+        if (!tag)
+        {
+            if (num_table_bits > init_table_bits)
             {
-                seg_index |= (1 << (INIT_TABLE_BITS - BUCKETS_PER_SEG));
+                seg_index |= (1ULL << (init_table_bits - BUCKETS_PER_SEG));
             }
             tag++;
         }
 
-        if (seg_index >= hash_table_.size())
+        short_tag = (tag >> tag_shift) & 0xFF;
+        if (!short_tag)
+        {
+            if (num_table_bits > init_table_bits + tag_shift)
+            {
+                seg_index |= (1ULL << (init_table_bits - BUCKETS_PER_SEG + tag_shift));
+            }
+            short_tag = 1;
+        }
+
+        if (seg_index >= num_segments)
+        {
+            seg_index = seg_index - (1ULL << (num_seg_bits - 1));
+        }
+
+        chain_idx = ShortTagHome(bucket_index, tag);
+        alt_idx = ShortTagSegment::AltIndex(chain_idx, short_tag);
+    }
+
+    // A split sorts a segment's tags by their next bit, so it needs one left
+    // of the 12, and in a short-tag table one among the stored bits.
+    inline bool CanExtend() const
+    {
+        const uint32_t tag_bits = short_tags_ ? tag_shift_ + ShortTagSegment::kTagBits : BITS_PER_TAG;
+        return CanSplit(NumSegments(), INIT_TABLE_BITS, tag_bits < BITS_PER_TAG ? tag_bits : BITS_PER_TAG);
+    }
+
+    template <class SegmentT>
+    void ExtendTable(vector<SegmentT *> &table, uint32_t tag_shift);
+    // Extend after an insert: the key is already stored, and a split that
+    // fails to allocate leaves a consistent table, so the insert still
+    // succeeds and the split waits for the next trigger.
+    void TryExtend()
+    {
+        try
+        {
+            Extend();
+        }
+        catch (const std::bad_alloc &)
         {
-            seg_index = seg_index - (1 << (NUM_SEG_BITS - 1));
         }
     }
 
+    // Compact, with the accounting updated once it succeeds.
+    template <class SegmentT>
+    void CompactSegment(SegmentT *seg);
+    template <class SegmentT>
+    void CompressTable(vector<SegmentT *> &table);
+
+    // Rebuilds the table with 8-bit tags, one segment at a time.
+    void ShortenTags();
+
+    // Recomputes sum_capacity_ and segment_bytes_ from the segments.
+    void CountSegments();
+
+    bool InsertShort(uint64_t hash, bool if_absent);
+    bool LookupShort(uint64_t hash) const;
+    bool DeleteShort(uint64_t hash);
+
+    // Insert, or with if_absent InsertIfAbsent.
+    bool InsertTag(uint64_t hash, bool if_absent);
+
+    static inline uint64_t HashKey(const char *item)
+    {
+        return HashKey(item, strlen(item));
+    }
+
+    // For binary keys, such as the 64-bit keys of a workload trace.
+    static inline uint64_t HashKey(const void *item, uint32_t len)
+    {
+        return BOBHash::run64(item, len, 3);
+    }
+
+    // Splits until there are as many segments as the item-count policy (or the
+    // chain budget) asks for, after num_items_ grew without inserts.
+    void Rebalance();
+
+    inline void GenerateIndexTagHash(const char *item, uint64_t &seg_index, uint32_t &bucket_index, uint32_t &tag) const
+    {
+        IndexTagFromHash(HashKey(item), INIT_TABLE_BITS, num_table_bits_, hash_table_.size(), seg_index, bucket_index, tag);
+    }
+
 public:
-    BambooFilter(uint32_t capacity, uint32_t split_condition_param);
+    // cache_aligned selects the Segment layout where no chain straddles a cache line;
+    // arena, if given, holds all chain data (see shared_bamboofilter.hpp).
+    BambooFilter(uint64_t capacity, uint32_t split_condition_param, bool cache_aligned = false,
+                 SegmentArena *arena = NULL);
+
+    // Deep copy; the copy's chains live in the same arena as other's.
+    BambooFilter(const BambooFilter &other);
 
     ~BambooFilter();
 
@@ -72,111 +300,598 @@ public:
     bool Lookup(const char *key) const;
     bool Delete(const char *key);
 
+    // Inserts key unless the filter already reports it, in one pass over the
+    // candidate chains; returns whether it inserted. For producers that resend
+    // keys: duplicates take no space and cannot trigger growth. A new key whose
+    // tag is a false positive is not inserted either and shares the matching
+    // tag, so delete a key only once per true result, or the other key's tag
+    // goes with it.
+    bool InsertIfAbsent(const char *key);
+
+    // The operations above with a hash already computed by HashKey, for callers
+    // that probe several filters with one key or hash outside a lock.
+    bool InsertHash(uint64_t hash);
+    bool InsertIfAbsentHash(uint64_t hash);
+    bool LookupHash(uint64_t hash) const;
+    bool DeleteHash(uint64_t hash);
+
+    // Starts loading the candidate chains of hash into cache, so a batch of
+    // operations can overlap its misses. A no-op once tags are shortened.
+    void PrefetchHash(uint64_t hash) const
+    {
+        if (short_tags_)
+        {
+            return;
+        }
+        uint64_t seg_index;
+        uint32_t bucket_index, tag;
+        IndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, hash_table_.size(), seg_index, bucket_index, tag);
+        hash_table_[seg_index]->Prefetch(bucket_index, tag);
+    }
+
     void Extend();
     void Compress();
+
+    // Adds every item of other to this filter without rehashing any key. Both
+    // tables are first split to the same number of segments (other through a
+    // copy, as it is left untouched); keys of matching segments then map to the
+    // same chains, so each pair is concatenated chain by chain and compacted,
+    // segments in parallel. Afterwards the table is split further to fit the
+    // larger item count. Both filters must have been built for the same capacity.
+    void Merge(const BambooFilter &other);
+
+    // Replaces the fixed split_condition_ item count with a lookup-cost budget:
+    // Extend as soon as lookups scan more than max_avg_scan buckets on average
+    // (both candidate chains, 2 * chain_capacity each), or, if max_chain_capacity
+    // is set, as soon as an insert grows a chain beyond it. Splits still follow
+    // next_split_idx_ (linear hashing), so an over-long segment is relieved when
+    // its turn comes; split and merged segments are compacted so their capacity
+    // tracks what they actually hold. Pass 0 to return to the item-count policy.
+    void SetChainBudget(double max_avg_scan, uint32_t max_chain_capacity = 0);
+
+    // Caps memory at max_bytes (0: no cap). Once SizeInBytes() exceeds it, the
+    // table is rebuilt in place with 8-bit tags: a third less memory per key for
+    // a higher false positive rate (see EffectiveFpr). This happens once. From
+    // then on the filter grows, more slowly, only while under max_bytes; over
+    // it, an insert is stored only if one of its two chains has a free slot,
+    // and otherwise rejected: Insert returns false and the key is not added.
+    // A single growth step may still cross the cap.
+    void SetMemoryBudget(uint64_t max_bytes);
+
+    uint32_t TagBits() const
+    {
+        return short_tags_ ? ShortTagSegment::kTagBits : BITS_PER_TAG;
+    }
+
+    // Expected false positive rate of a lookup at the current load: each tag in
+    // the two candidate chains matches with probability 2^-f, where f counts
+    // the stored tag bits that splits have not already fixed for its segment.
+    double EffectiveFpr() const;
+
+    double AvgBucketsScanned() const
+    {
+        return 2.0 * sum_capacity_ / NumSegments();
+    }
+
+    uint64_t SizeInBytes() const;
 };
 
-BambooFilter::BambooFilter(uint32_t capacity, uint32_t split_condition_param)
-    : INIT_TABLE_BITS((uint32_t)ceil(log2((double)(capacity / 4))))
+BambooFilter::BambooFilter(uint64_t capacity, uint32_t split_condition_param, bool cache_aligned,
+                           SegmentArena *arena)
+    : INIT_TABLE_BITS((uint32_t)ceil(log2((double)(capacity / 4)))), arena_(arena),
+      max_bytes_(0), short_tags_(false), tag_shift_(0)
 {
     num_table_bits_ = INIT_TABLE_BITS;
 
-    for (int num_segment = 0; num_segment < (1 << NUM_SEG_BITS); num_segment++)
+    for (uint64_t num_segment = 0; num_segment < (1ULL << NUM_SEG_BITS); num_segment++)
     {
-        hash_table_.push_back(new Segment(1 << BUCKETS_PER_SEG));
+        hash_table_.push_back(new Segment(1 << BUCKETS_PER_SEG, cache_aligned, arena));
     }
 
-    split_condition_ = uint32_t(split_condition_param * 4 * (1 << BUCKETS_PER_SEG)) - 1;
+    split_condition_ = uint64_t(split_condition_param) * 4 * (1ULL << BUCKETS_PER_SEG) - 1;
     next_split_idx_ = 0;
     num_items_ = 0;
+    CountSegments();
+    max_avg_scan_ = 0;
+    max_chain_capacity_ = 0;
+}
+
+BambooFilter::BambooFilter(const BambooFilter &other)
+    : INIT_TABLE_BITS(other.INIT_TABLE_BITS),
+      num_table_bits_(other.num_table_bits_),
+      arena_(other.arena_),
+      max_bytes_(other.max_bytes_),
+      short_tags_(other.short_tags_),
+      tag_shift_(other.tag_shift_),
+      split_condition_(other.split_condition_),
+      next_split_idx_(other.next_split_idx_),
+      num_items_(other.num_items_),
+      sum_capacity_(other.sum_capacity_),
+      segment_bytes_(other.segment_bytes_),
+      max_avg_scan_(other.max_avg_scan_),
+      max_chain_capacity_(other.max_chain_capacity_)
+{
+    for (uint64_t segment_idx = 0; segment_idx < other.hash_table_.size(); segment_idx++)
+    {
+        hash_table_.push_back(new Segment(*other.hash_table_[segment_idx]));
+    }
+    for (uint64_t segment_idx = 0; segment_idx < other.short_table_.size(); segment_idx++)
+    {
+        short_table_.push_back(new ShortTagSegment(*other.short_table_[segment_idx]));
+    }
 }
 
 BambooFilter::~BambooFilter()
 {
-    for (uint32_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
+    for (uint64_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
     {
         delete hash_table_[segment_idx];
     }
+    for (uint64_t segment_idx = 0; segment_idx < short_table_.size(); segment_idx++)
+    {
+        delete short_table_[segment_idx];
+    }
 }
 
 bool BambooFilter::Insert(const char *key)
 {
-    uint32_t seg_index, bucket_index, tag;
+    return InsertHash(HashKey(key));
+}
+
+bool BambooFilter::InsertHash(uint64_t hash)
+{
+    return InsertTag(hash, false);
+}
 
-    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
+bool BambooFilter::InsertIfAbsent(const char *key)
+{
+    return InsertTag(HashKey(key), true);
+}
 
-    hash_table_[seg_index]->Insert(bucket_index, tag);
+bool BambooFilter::InsertIfAbsentHash(uint64_t hash)
+{
+    return InsertTag(hash, true);
+}
+
+bool BambooFilter::InsertTag(uint64_t hash, bool if_absent)
+{
+    if (short_tags_)
+    {
+        return InsertShort(hash, if_absent);
+    }
+
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+
+    LATENCY_START();
+    IndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, hash_table_.size(), seg_index, bucket_index, tag);
+
+    Segment *seg = hash_table_[seg_index];
+    const uint32_t old_capacity = seg->ChainCapacity();
+    const uint64_t old_bytes = seg->SizeInBytes();
+    if (if_absent)
+    {
+        if (!seg->InsertIfAbsent(bucket_index, tag))
+        {
+            LATENCY_RECORD(kLatencyInsert);
+            return false;
+        }
+    }
+    else
+    {
+        seg->Insert(bucket_index, tag);
+    }
+    sum_capacity_ += seg->ChainCapacity() - old_capacity;
+    segment_bytes_ += seg->SizeInBytes() - old_bytes;
 
     num_items_++;
 
-    if (!(num_items_ & split_condition_))
+    bool grown = seg->ChainCapacity() != old_capacity;
+    if ((max_avg_scan_ ? OverChainBudget(seg->ChainCapacity()) : !(num_items_ & split_condition_)) && CanExtend())
     {
-        Extend();
+        TryExtend();
+        grown = true;
+        LATENCY_RECORD(kLatencyInsertExtend);
+    }
+    else
+    {
+        LATENCY_RECORD(grown ? kLatencyInsertGrow : kLatencyInsert);
     }
 
+    if (max_bytes_ && grown && SizeInBytes() > max_bytes_)
+    {
+        ShortenTags();
+    }
+    return true;
+}
+
+bool BambooFilter::InsertShort(uint64_t hash, bool if_absent)
+{
+    uint64_t seg_index;
+    uint32_t chain_idx, alt_idx;
+    uint8_t tag;
+    ShortIndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, short_table_.size(), tag_shift_,
+                          seg_index, chain_idx, alt_idx, tag);
+
+    ShortTagSegment *seg = short_table_[seg_index];
+    if (if_absent && seg->Lookup(chain_idx, alt_idx, tag))
+    {
+        return false;
+    }
+    if (max_bytes_ && SizeInBytes() > max_bytes_)
+    {
+        // over the budget even with short tags: take free slots only
+        if (!seg->TryInsert(chain_idx, alt_idx, tag))
+        {
+            return false;
+        }
+        num_items_++;
+        return true;
+    }
+    const uint32_t old_capacity = seg->ChainCapacity();
+    const uint64_t old_bytes = seg->SizeInBytes();
+    seg->Insert(chain_idx, tag);
+    sum_capacity_ += seg->ChainCapacity() - old_capacity;
+    segment_bytes_ += seg->SizeInBytes() - old_bytes;
+
+    num_items_++;
+
+    if ((max_avg_scan_ ? OverChainBudget(seg->ChainCapacity()) : !(num_items_ & split_condition_)) && CanExtend())
+    {
+        TryExtend();
+    }
     return true;
 }
 
 bool BambooFilter::Lookup(const char *key) const
 {
-    uint32_t seg_index, bucket_index, tag;
+    return LookupHash(HashKey(key));
+}
+
+bool BambooFilter::LookupHash(uint64_t hash) const
+{
+    if (short_tags_)
+    {
+        return LookupShort(hash);
+    }
 
-    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
-    return hash_table_[seg_index]->Lookup(bucket_index, tag);
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+
+    LATENCY_START();
+    IndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, hash_table_.size(), seg_index, bucket_index, tag);
+    const bool found = hash_table_[seg_index]->Lookup(bucket_index, tag);
+    LATENCY_RECORD(Segment::IsShortChain(hash_table_[seg_index]->ChainCapacity()) ? kLatencyLookup : kLatencyLookupLongChain);
+    return found;
+}
+
+bool BambooFilter::LookupShort(uint64_t hash) const
+{
+    uint64_t seg_index;
+    uint32_t chain_idx, alt_idx;
+    uint8_t tag;
+    ShortIndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, short_table_.size(), tag_shift_,
+                          seg_index, chain_idx, alt_idx, tag);
+    return short_table_[seg_index]->Lookup(chain_idx, alt_idx, tag);
 }
 
 bool BambooFilter::Delete(const char *key)
 {
-    uint32_t seg_index, bucket_index, tag;
-    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
+    return DeleteHash(HashKey(key));
+}
+
+bool BambooFilter::DeleteHash(uint64_t hash)
+{
+    if (short_tags_)
+    {
+        return DeleteShort(hash);
+    }
+
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+    LATENCY_START();
+    IndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, hash_table_.size(), seg_index, bucket_index, tag);
 
     if (hash_table_[seg_index]->Delete(bucket_index, tag))
     {
         num_items_--;
-        if (!(num_items_ & split_condition_))
+        if (max_avg_scan_ ? UnderChainBudget() : CompressDue())
         {
             Compress();
+            LATENCY_RECORD(kLatencyDeleteCompress);
+        }
+        else
+        {
+            LATENCY_RECORD(kLatencyDelete);
         }
         return true;
     }
     else
     {
+        LATENCY_RECORD(kLatencyDelete);
         return false;
     }
 }
 
-void BambooFilter::Extend()
+bool BambooFilter::DeleteShort(uint64_t hash)
 {
-    Segment *src = hash_table_[next_split_idx_];
-    Segment *dst = new Segment(*src);
-    hash_table_.push_back(dst);
+    uint64_t seg_index;
+    uint32_t chain_idx, alt_idx;
+    uint8_t tag;
+    ShortIndexTagFromHash(hash, INIT_TABLE_BITS, num_table_bits_, short_table_.size(), tag_shift_,
+                          seg_index, chain_idx, alt_idx, tag);
 
-    uint32_t num_seg_bits_ = (uint32_t)ceil(log2((double)hash_table_.size()));
-    num_table_bits_ = num_seg_bits_ + BUCKETS_PER_SEG;
+    if (!short_table_[seg_index]->Delete(chain_idx, alt_idx, tag))
+    {
+        return false;
+    }
+    num_items_--;
+    if (max_avg_scan_ ? UnderChainBudget() : CompressDue())
+    {
+        Compress();
+    }
+    return true;
+}
 
-    src->EraseEle(true, ACTV_TAG_BIT - 1);
-    dst->EraseEle(false, ACTV_TAG_BIT - 1);
+void BambooFilter::Extend()
+{
+    if (short_tags_)
+    {
+        ExtendTable(short_table_, tag_shift_);
+    }
+    else
+    {
+        ExtendTable(hash_table_, 0);
+    }
+}
 
-    next_split_idx_++;
-    if (next_split_idx_ == (1UL << (num_seg_bits_ - 1)))
+// tag_shift: how many low bits of the 12-bit tag the table's tags omit
+template <class SegmentT>
+void BambooFilter::ExtendTable(vector<SegmentT *> &table, uint32_t tag_shift)
+{
+    SegmentT *src = table[next_split_idx_];
+    SegmentT *dst = SplitSegment(table, INIT_TABLE_BITS, tag_shift, num_table_bits_, next_split_idx_);
+    sum_capacity_ += dst->ChainCapacity();
+    segment_bytes_ += dst->SizeInBytes();
+
+    // The split is complete; packing may throw, one segment at a time.
+    // A short-tag table only exists over budget, so it keeps no split slack.
+    if (max_avg_scan_ || short_tags_)
     {
-        next_split_idx_ = 0;
+        CompactSegment(src);
+        CompactSegment(dst);
     }
 }
 
-void BambooFilter::Compress()
+template <class SegmentT>
+SegmentT *BambooFilter::SplitSegment(vector<SegmentT *> &table, uint32_t init_table_bits, uint32_t tag_shift,
+                                     uint32_t &num_table_bits, uint64_t &next_split_idx)
 {
-    uint32_t num_seg_bits_ = (uint32_t)ceil(log2((double)(hash_table_.size() - 1)));
-    num_table_bits_ = num_seg_bits_ + BUCKETS_PER_SEG;
-    if (!next_split_idx_)
+    SegmentT *src = table[next_split_idx];
+    SegmentT *dst = new SegmentT(*src);
+    table.push_back(dst);
+
+    const uint32_t num_seg_bits = (uint32_t)ceil(log2((double)table.size()));
+    num_table_bits = num_seg_bits + BUCKETS_PER_SEG;
+
+    src->EraseEle(true, num_table_bits - init_table_bits - 1 - tag_shift);
+    dst->EraseEle(false, num_table_bits - init_table_bits - 1 - tag_shift);
+
+    next_split_idx++;
+    if (next_split_idx == (1ULL << (num_seg_bits - 1)))
     {
-        next_split_idx_ = (1UL << (num_seg_bits_ - 1));
+        next_split_idx = 0;
     }
-    next_split_idx_--;
+    return dst;
+}
 
-    Segment *src = hash_table_[next_split_idx_];
-    Segment *dst = hash_table_.back();
+template <class SegmentT>
+SegmentT *BambooFilter::MergeSegment(vector<SegmentT *> &table, uint32_t &num_table_bits, uint64_t &next_split_idx)
+{
+    const uint64_t split_idx = MergeTarget(table.size(), next_split_idx);
+    SegmentT *src = table[split_idx];
+    SegmentT *dst = table.back();
     src->Absorb(dst);
     delete dst;
-    hash_table_.pop_back();
-}
\ No newline at end of file
+    table.pop_back();
+
+    num_table_bits = (uint32_t)ceil(log2((double)table.size())) + BUCKETS_PER_SEG;
+    next_split_idx = split_idx;
+    return src;
+}
+
+template <class SegmentT>
+void BambooFilter::CompactSegment(SegmentT *seg)
+{
+    const uint32_t old_capacity = seg->ChainCapacity();
+    const uint64_t old_bytes = seg->SizeInBytes();
+    seg->Compact();
+    sum_capacity_ = sum_capacity_ - old_capacity + seg->ChainCapacity();
+    segment_bytes_ = segment_bytes_ - old_bytes + seg->SizeInBytes();
+}
+
+void BambooFilter::Compress()
+{
+    if (short_tags_)
+    {
+        CompressTable(short_table_);
+    }
+    else
+    {
+        CompressTable(hash_table_);
+    }
+}
+
+template <class SegmentT>
+void BambooFilter::CompressTable(vector<SegmentT *> &table)
+{
+    SegmentT *src = table[MergeTarget(table.size(), next_split_idx_)];
+    const uint64_t old_bytes = src->SizeInBytes() + table.back()->SizeInBytes();
+    MergeSegment(table, num_table_bits_, next_split_idx_);
+    segment_bytes_ += src->SizeInBytes() - old_bytes;
+
+    if (max_avg_scan_ || short_tags_)
+    {
+        CompactSegment(src);
+    }
+}
+
+void BambooFilter::Merge(const BambooFilter &other)
+{
+    if (other.INIT_TABLE_BITS != INIT_TABLE_BITS)
+    {
+        throw std::invalid_argument("BambooFilter::Merge: filters built for different capacities");
+    }
+    if (short_tags_ || other.short_tags_)
+    {
+        throw std::logic_error("BambooFilter::Merge: filters with shortened tags cannot be merged");
+    }
+
+    // With equal INIT_TABLE_BITS the segment count alone fixes num_table_bits_
+    // and next_split_idx_, hence where every key goes.
+    while (hash_table_.size() < other.hash_table_.size())
+    {
+        Extend();
+    }
+    const BambooFilter *src = &other;
+    BambooFilter *split_copy = NULL;
+    if (other.hash_table_.size() < hash_table_.size())
+    {
+        split_copy = new BambooFilter(other);
+        while (split_copy->hash_table_.size() < hash_table_.size())
+        {
+            split_copy->Extend();
+        }
+        src = split_copy;
+    }
+
+    // An arena is not thread-safe, so arena-backed segments are merged serially.
+    const int64_t num_segments = hash_table_.size();
+#pragma omp parallel for if (!arena_)
+    for (int64_t segment_idx = 0; segment_idx < num_segments; segment_idx++)
+    {
+        hash_table_[segment_idx]->Absorb(src->hash_table_[segment_idx]);
+        hash_table_[segment_idx]->Compact();
+    }
+    delete split_copy;
+
+    num_items_ += other.num_items_;
+    CountSegments();
+    Rebalance();
+}
+
+void BambooFilter::Rebalance()
+{
+    if (max_avg_scan_)
+    {
+        while (2.0 * sum_capacity_ > max_avg_scan_ * NumSegments() && CanExtend())
+        {
+            Extend();
+        }
+        return;
+    }
+    // Insert extends once every split_condition_ + 1 items.
+    const uint64_t initial_segments = 1ULL << (INIT_TABLE_BITS - BUCKETS_PER_SEG);
+    while (NumSegments() < initial_segments + num_items_ / (split_condition_ + 1) && CanExtend())
+    {
+        Extend();
+    }
+}
+
+uint64_t BambooFilter::SizeInBytes() const
+{
+    return sizeof(BambooFilter) + hash_table_.capacity() * sizeof(Segment *) +
+           short_table_.capacity() * sizeof(ShortTagSegment *) + segment_bytes_;
+}
+
+void BambooFilter::CountSegments()
+{
+    sum_capacity_ = 0;
+    segment_bytes_ = 0;
+    for (uint64_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
+    {
+        sum_capacity_ += hash_table_[segment_idx]->ChainCapacity();
+        segment_bytes_ += hash_table_[segment_idx]->SizeInBytes();
+    }
+    for (uint64_t segment_idx = 0; segment_idx < short_table_.size(); segment_idx++)
+    {
+        sum_capacity_ += short_table_[segment_idx]->ChainCapacity();
+        segment_bytes_ += short_table_[segment_idx]->SizeInBytes();
+    }
+}
+
+void BambooFilter::SetChainBudget(double max_avg_scan, uint32_t max_chain_capacity)
+{
+    max_avg_scan_ = max_avg_scan;
+    max_chain_capacity_ = max_chain_capacity;
+}
+
+void BambooFilter::SetMemoryBudget(uint64_t max_bytes)
+{
+    max_bytes_ = max_bytes;
+    if (max_bytes_ && !short_tags_ && SizeInBytes() > max_bytes_)
+    {
+        ShortenTags();
+    }
+}
+
+void BambooFilter::ShortenTags()
+{
+    // A split uses the next tag bit only in the segments it has reached. Merge
+    // back to a table where every segment was split equally often, so that the
+    // bits below tag_shift_ are the used ones in every segment.
+    while (next_split_idx_)
+    {
+        Compress();
+    }
+    tag_shift_ = ACTV_TAG_BIT;
+
+    for (uint64_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
+    {
+        Segment *seg = hash_table_[segment_idx];
+        ShortTagSegment *short_seg = new ShortTagSegment(1 << BUCKETS_PER_SEG, seg->ChainCapacity());
+        const uint32_t shift = tag_shift_;
+        // the home is the same from both candidate chains, so a tag needs no key;
+        // inserting rather than putting it there spreads it over home and alternate
+        seg->ForEachTag([short_seg, shift](uint32_t chain_idx, uint32_t tag) {
+            uint8_t short_tag = (tag >> shift) & 0xFF;
+            short_seg->Insert(ShortTagHome(chain_idx, tag), short_tag ? short_tag : 1);
+        });
+        delete seg;
+        short_seg->Compact();
+        short_table_.push_back(short_seg);
+    }
+    hash_table_.clear();
+    short_tags_ = true;
+    CountSegments();
+    // split back what the first step merged, now at 8-bit cost
+    Rebalance();
+}
+
+double BambooFilter::EffectiveFpr() const
+{
+    const uint64_t initial_segments = 1ULL << (INIT_TABLE_BITS - BUCKETS_PER_SEG);
+    const uint64_t num_segments = NumSegments();
+    // every segment was split level or level + 1 times
+    uint32_t level = 0;
+    while ((initial_segments << (level + 1)) <= num_segments)
+    {
+        level++;
+    }
+    const uint32_t stored_bits = short_tags_ ? std::min(ShortTagSegment::kTagBits, BITS_PER_TAG - tag_shift_) : BITS_PER_TAG;
+
+    double fpr = 0;
+    for (uint64_t segment_idx = 0; segment_idx < num_segments; segment_idx++)
+    {
+        const uint32_t splits = level + (segment_idx < next_split_idx_ || segment_idx >= (initial_segments << level));
+        // share of all keys hashed to this segment, and the tags of two chains
+        const double share = 1.0 / (initial_segments << splits);
+        const double tags = 2.0 * num_items_ * share / (1 << BUCKETS_PER_SEG);
+        // a short-tag segment merged below tag_shift_ has all its stored bits free
+        const int used_bits = (int)splits - (int)(short_tags_ ? tag_shift_ : 0);
+        const int free_bits = (int)stored_bits - std::max(used_bits, 0);
+        const double p = free_bits > 0 ? 1.0 / (1ULL << free_bits) : 1.0;
+        fpr += share * (1 - pow(1 - p, tags));
+    }
+    return fpr;
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+#include "bamboofilter/predefine.h"
+#include "bamboofilter/segment.hpp"
+
+using std::vector;
+
+// Segment variant that keeps a kValueBits-bit value next to every 12-bit tag.
+// A bucket is the usual 6 bytes of packed tags followed by the four values
+// packed into (4 * kValueBits + 7) / 8 bytes, so the value is in the same
+// cache line as its tag and a lookup still probes exactly two chains.
+template <uint32_t kValueBits>
+class MapSegment
+{
+    static_assert(kValueBits >= 1 && kValueBits <= 8, "values are 1 to 8 bits wide");
+
+private:
+    static const uint32_t kTagsPerBucket = 4;
+    static const uint32_t kValueMask = (1U << kValueBits) - 1;
+    static const uint32_t kTagBytes = (BITS_PER_TAG * kTagsPerBucket + 7) / 8;
+    static const uint32_t kValueBytes = (kValueBits * kTagsPerBucket + 7) / 8;
+
+    static const uint32_t bucket_size = kTagBytes + kValueBytes;
+    static const uint32_t safe_pad = sizeof(uint64_t); // 8B loads at tags and values
+
+private:
+    const uint32_t chain_num;
+    uint32_t chain_capacity;
+    uint32_t insert_cur;
+    char *data_base;
+
+    char *Bucket(uint32_t chain_idx, uint32_t i) const
+    {
+        return data_base + (chain_idx * chain_capacity + i) * bucket_size;
+    }
+
+    static uint32_t ReadValue(const char *p, uint32_t idx)
+    {
+        return (*((uint32_t *)(p + kTagBytes)) >> (idx * kValueBits)) & kValueMask;
+    }
+
+    // Read-modify-write of a 32-bit word: bytes past this bucket's values are
+    // written back unchanged.
+    static void WriteValue(char *p, uint32_t idx, uint32_t value)
+    {
+        uint32_t *w = (uint32_t *)(p + kTagBytes);
+        *w = (*w & ~(kValueMask << (idx * kValueBits))) | ((value & kValueMask) << (idx * kValueBits));
+    }
+
+    // Slot of the first tag equal to tag, or -1. The lowest haszero12 flag is
+    // exact; only lanes above a match can be flagged spuriously.
+    static int FindTag(const char *p, uint32_t tag)
+    {
+        uint64_t v = *((uint64_t *)p);
+        uint64_t hit = hasvalue12(v, tag);
+        return hit ? __builtin_ctzll(hit) / BITS_PER_TAG : -1;
+    }
+
+    void Grow()
+    {
+        const uint32_t old_chain_len = chain_capacity * bucket_size;
+        const uint32_t new_chain_len = (chain_capacity + 1) * bucket_size;
+        char *new_data_base = new char[chain_num * new_chain_len + safe_pad];
+        memset(new_data_base, 0, chain_num * new_chain_len + safe_pad);
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            memcpy(new_data_base + i * new_chain_len, data_base + i * old_chain_len, old_chain_len);
+        }
+        delete[] data_base;
+        data_base = new_data_base;
+        chain_capacity++;
+    }
+
+public:
+    MapSegment(const uint32_t chain_num)
+        : chain_num(chain_num),
+          chain_capacity(1),
+          insert_cur(0)
+    {
+        data_base = new char[chain_num * chain_capacity * bucket_size + safe_pad];
+        memset(data_base, 0, chain_num * chain_capacity * bucket_size + safe_pad);
+    }
+
+    MapSegment(const MapSegment &s)
+        : chain_num(s.chain_num),
+          chain_capacity(s.chain_capacity),
+          insert_cur(0)
+    {
+        data_base = new char[chain_num * chain_capacity * bucket_size + safe_pad];
+        memcpy(data_base, s.data_base, chain_num * chain_capacity * bucket_size + safe_pad);
+    }
+
+    ~MapSegment()
+    {
+        delete[] data_base;
+    }
+
+    bool Insert(uint32_t chain_idx, uint32_t curtag, uint32_t curvalue)
+    {
+        char *bucket_p;
+        for (uint32_t count = 0; count < MAX_CUCKOO_KICK; count++)
+        {
+            bucket_p = Bucket(chain_idx, insert_cur);
+            bool kickout = count > 0;
+
+            for (uint32_t tag_idx = 0; tag_idx < kTagsPerBucket; tag_idx++)
+            {
+                if (0 == Segment::ReadTag(bucket_p, tag_idx))
+                {
+                    Segment::WriteTag(bucket_p, tag_idx, curtag);
+                    WriteValue(bucket_p, tag_idx, curvalue);
+                    return true;
+                }
+            }
+
+            if (kickout)
+            {
+                uint32_t tag_idx = rand() % kTagsPerBucket;
+                uint32_t oldtag = Segment::ReadTag(bucket_p, tag_idx);
+                uint32_t oldvalue = ReadValue(bucket_p, tag_idx);
+                Segment::WriteTag(bucket_p, tag_idx, curtag);
+                WriteValue(bucket_p, tag_idx, curvalue);
+                curtag = oldtag;
+                curvalue = oldvalue;
+            }
+            chain_idx = Segment::AltIndex(chain_idx, curtag);
+        }
+
+        insert_cur++;
+        if (insert_cur >= chain_capacity)
+        {
+            Grow();
+        }
+        return Insert(chain_idx, curtag, curvalue);
+    }
+
+    bool Lookup(uint32_t chain_idx, uint32_t tag, uint32_t &value) const
+    {
+        uint32_t chains[2] = {chain_idx, Segment::AltIndex(chain_idx, tag)};
+        for (int c = 0; c < 2; c++)
+        {
+            for (uint32_t i = 0; i < chain_capacity; i++)
+            {
+                const char *p = Bucket(chains[c], i);
+                int slot = FindTag(p, tag);
+                if (slot >= 0)
+                {
+                    value = ReadValue(p, slot);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool Delete(uint32_t chain_idx, uint32_t tag)
+    {
+        uint32_t chains[2] = {chain_idx, Segment::AltIndex(chain_idx, tag)};
+        for (int c = 0; c < 2; c++)
+        {
+            for (uint32_t i = 0; i < chain_capacity; i++)
+            {
+                char *p = Bucket(chains[c], i);
+                int slot = FindTag(p, tag);
+                if (slot >= 0)
+                {
+                    Segment::WriteTag(p, slot, 0);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Same split as Segment::EraseEle: doErase only rewrites the 48 tag bits of
+    // a bucket, and a value behind a cleared tag is dead.
+    void EraseEle(bool is_src, uint32_t actv_bit)
+    {
+        for (uint32_t i = 0; i < chain_num * chain_capacity; i++)
+        {
+            Segment::doErase(data_base + i * bucket_size, is_src, actv_bit);
+        }
+        insert_cur = 0;
+    }
+
+    // Allocates before it changes anything (see BambooFilter::MergeSegment).
+    void Absorb(const MapSegment *segment)
+    {
+        const char *p1 = data_base;
+        const uint32_t len1 = chain_capacity * bucket_size;
+        const char *p2 = segment->data_base;
+        const uint32_t len2 = segment->chain_capacity * bucket_size;
+
+        char *new_data_base = new char[chain_num * (len1 + len2) + safe_pad];
+        memset(new_data_base, 0, chain_num * (len1 + len2) + safe_pad);
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            memcpy(new_data_base + i * (len1 + len2), p1 + i * len1, len1);
+            memcpy(new_data_base + i * (len1 + len2) + len1, p2 + i * len2, len2);
+        }
+        delete[] data_base;
+        data_base = new_data_base;
+        chain_capacity += segment->chain_capacity;
+        insert_cur = 0;
+    }
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(MapSegment) + chain_num * chain_capacity * bucket_size + safe_pad;
+    }
+};
+
+// Approximate map from keys to small values (e.g. a 4-bit shard id) with the
+// same hashing and elastic segment splitting as BambooFilter: it indexes with
+// BambooFilter::IndexTagFromHash and splits and merges with its SplitSegment
+// and MergeSegment, under the item-count policy. Lookup returns
+// the value stored with the key's tag in one probe; like a filter it may
+// answer for an absent key (probability ~ the filter's FPR) and then returns
+// that colliding entry's value.
+template <uint32_t kValueBits>
+class BambooMap
+{
+public:
+    const uint32_t INIT_TABLE_BITS;
+    uint32_t num_table_bits_;
+
+    vector<MapSegment<kValueBits> *> hash_table_;
+
+    uint64_t split_condition_;
+
+    uint64_t next_split_idx_;
+    uint64_t num_items_;
+
+    inline void GenerateIndexTagHash(const char *item, uint64_t &seg_index, uint32_t &bucket_index, uint32_t &tag) const
+    {
+        BambooFilter::IndexTagFromHash(BambooFilter::HashKey(item), INIT_TABLE_BITS, num_table_bits_,
+                                       hash_table_.size(), seg_index, bucket_index, tag);
+    }
+
+public:
+    BambooMap(uint64_t capacity, uint32_t split_condition_param);
+
+    ~BambooMap();
+
+    bool Insert(const char *key, uint32_t value);
+    bool Lookup(const char *key, uint32_t &value) const;
+    bool Delete(const char *key);
+
+    void Extend();
+    void Compress();
+
+    uint64_t SizeInBytes() const;
+};
+
+template <uint32_t kValueBits>
+BambooMap<kValueBits>::BambooMap(uint64_t capacity, uint32_t split_condition_param)
+    : INIT_TABLE_BITS((uint32_t)ceil(log2((double)(capacity / 4))))
+{
+    num_table_bits_ = INIT_TABLE_BITS;
+
+    for (uint64_t num_segment = 0; num_segment < (1ULL << NUM_SEG_BITS); num_segment++)
+    {
+        hash_table_.push_back(new MapSegment<kValueBits>(1 << BUCKETS_PER_SEG));
+    }
+
+    split_condition_ = uint64_t(split_condition_param) * 4 * (1ULL << BUCKETS_PER_SEG) - 1;
+    next_split_idx_ = 0;
+    num_items_ = 0;
+}
+
+template <uint32_t kValueBits>
+BambooMap<kValueBits>::~BambooMap()
+{
+    for (uint64_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
+    {
+        delete hash_table_[segment_idx];
+    }
+}
+
+template <uint32_t kValueBits>
+bool BambooMap<kValueBits>::Insert(const char *key, uint32_t value)
+{
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+
+    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
+    hash_table_[seg_index]->Insert(bucket_index, tag, value);
+
+    num_items_++;
+    if (!(num_items_ & split_condition_) && BambooFilter::CanSplit(hash_table_.size(), INIT_TABLE_BITS, BITS_PER_TAG))
+    {
+        Extend();
+    }
+    return true;
+}
+
+template <uint32_t kValueBits>
+bool BambooMap<kValueBits>::Lookup(const char *key, uint32_t &value) const
+{
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+
+    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
+    return hash_table_[seg_index]->Lookup(bucket_index, tag, value);
+}
+
+template <uint32_t kValueBits>
+bool BambooMap<kValueBits>::Delete(const char *key)
+{
+    uint64_t seg_index;
+    uint32_t bucket_index, tag;
+
+    GenerateIndexTagHash(key, seg_index, bucket_index, tag);
+    if (hash_table_[seg_index]->Delete(bucket_index, tag))
+    {
+        num_items_--;
+        if (BambooFilter::MergeDue(num_items_, split_condition_, hash_table_.size(), INIT_TABLE_BITS))
+        {
+            Compress();
+        }
+        return true;
+    }
+    return false;
+}
+
+template <uint32_t kValueBits>
+void BambooMap<kValueBits>::Extend()
+{
+    BambooFilter::SplitSegment(hash_table_, INIT_TABLE_BITS, 0, num_table_bits_, next_split_idx_);
+}
+
+template <uint32_t kValueBits>
+void BambooMap<kValueBits>::Compress()
+{
+    BambooFilter::MergeSegment(hash_table_, num_table_bits_, next_split_idx_);
+}
+
+template <uint32_t kValueBits>
+uint64_t BambooMap<kValueBits>::SizeInBytes() const
+{
+    uint64_t size = sizeof(BambooMap) + hash_table_.capacity() * sizeof(MapSegment<kValueBits> *);
+    for (uint64_t segment_idx = 0; segment_idx < hash_table_.size(); segment_idx++)
+    {
+        size += hash_table_[segment_idx]->SizeInBytes();
+    }
+    return size;
+}
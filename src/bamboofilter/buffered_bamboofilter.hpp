@@ -0,0 +1,188 @@
+// Write-combining front end for many threads inserting into one BambooFilter.
+//
+// The filter itself is guarded by a reader-writer lock. Taking the write lock
+// for every insert makes the lock's cache line bounce between all ingest
+// threads, so each thread instead goes through its own Writer: Insert hashes
+// the key and appends the hash to a small local buffer. A full buffer is
+// applied under one write lock, so one lock round trip covers a whole batch.
+// Batches are applied in arrival order: sorting them by segment, or prefetching
+// ahead within a batch, cost more than it saved in test/ingest.
+//
+// A Writer's own Lookup and Delete also see the hashes still in its buffer.
+// Other threads see them only after the Writer's Flush() (called as well when
+// the buffer fills and on destruction); Flush() releases the lock, so whatever
+// a thread observes after that point includes the batch.
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+
+using std::vector;
+
+class BufferedBambooFilter
+{
+public:
+    static const uint32_t kDefaultBufferSize = 128;
+
+    BufferedBambooFilter(uint64_t capacity, uint32_t split_condition_param);
+    ~BufferedBambooFilter();
+
+    // Per-thread handle; not to be shared between threads.
+    class Writer
+    {
+    public:
+        explicit Writer(BufferedBambooFilter &filter, uint32_t buffer_size = kDefaultBufferSize);
+        ~Writer();
+
+        bool Insert(const char *key);
+        bool Lookup(const char *key) const;
+        bool Delete(const char *key);
+
+        // Applies the buffered inserts to the shared filter.
+        void Flush();
+
+        uint32_t Buffered() const
+        {
+            return buffer_.size();
+        }
+
+    private:
+        BufferedBambooFilter &filter_;
+        const uint32_t buffer_size_;
+        vector<uint64_t> buffer_;
+    };
+
+    // Sees everything flushed so far, by any Writer.
+    bool Lookup(const char *key) const;
+
+    uint64_t NumItems() const;
+    uint64_t SizeInBytes() const;
+
+private:
+    BambooFilter filter_;
+    mutable pthread_rwlock_t lock_;
+    void InsertBatch(const uint64_t *hashes, uint32_t n);
+    bool LookupHash(uint64_t hash) const;
+    bool DeleteHash(uint64_t hash);
+};
+
+BufferedBambooFilter::BufferedBambooFilter(uint64_t capacity, uint32_t split_condition_param)
+    : filter_(capacity, split_condition_param)
+{
+    pthread_rwlock_init(&lock_, NULL);
+}
+
+BufferedBambooFilter::~BufferedBambooFilter()
+{
+    pthread_rwlock_destroy(&lock_);
+}
+
+void BufferedBambooFilter::InsertBatch(const uint64_t *hashes, uint32_t n)
+{
+    pthread_rwlock_wrlock(&lock_);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        filter_.InsertHash(hashes[i]);
+    }
+    pthread_rwlock_unlock(&lock_);
+}
+
+// Lookups share the lock: a segment keeps no state of its own for them (the
+// long-chain kernel copies into a per-thread scratch buffer).
+bool BufferedBambooFilter::LookupHash(uint64_t hash) const
+{
+    pthread_rwlock_rdlock(&lock_);
+    const bool found = filter_.LookupHash(hash);
+    pthread_rwlock_unlock(&lock_);
+    return found;
+}
+
+bool BufferedBambooFilter::DeleteHash(uint64_t hash)
+{
+    pthread_rwlock_wrlock(&lock_);
+    const bool deleted = filter_.DeleteHash(hash);
+    pthread_rwlock_unlock(&lock_);
+    return deleted;
+}
+
+bool BufferedBambooFilter::Lookup(const char *key) const
+{
+    return LookupHash(BambooFilter::HashKey(key));
+}
+
+uint64_t BufferedBambooFilter::NumItems() const
+{
+    pthread_rwlock_rdlock(&lock_);
+    const uint64_t n = filter_.num_items_;
+    pthread_rwlock_unlock(&lock_);
+    return n;
+}
+
+uint64_t BufferedBambooFilter::SizeInBytes() const
+{
+    pthread_rwlock_rdlock(&lock_);
+    const uint64_t bytes = filter_.SizeInBytes();
+    pthread_rwlock_unlock(&lock_);
+    return bytes;
+}
+
+BufferedBambooFilter::Writer::Writer(BufferedBambooFilter &filter, uint32_t buffer_size)
+    : filter_(filter), buffer_size_(buffer_size ? buffer_size : 1)
+{
+    buffer_.reserve(buffer_size_);
+}
+
+BufferedBambooFilter::Writer::~Writer()
+{
+    Flush();
+}
+
+bool BufferedBambooFilter::Writer::Insert(const char *key)
+{
+    buffer_.push_back(BambooFilter::HashKey(key));
+    if (buffer_.size() >= buffer_size_)
+    {
+        Flush();
+    }
+    return true;
+}
+
+bool BufferedBambooFilter::Writer::Lookup(const char *key) const
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    // full hashes: a buffered match is exact, not a false positive
+    if (std::find(buffer_.begin(), buffer_.end(), hash) != buffer_.end())
+    {
+        return true;
+    }
+    return filter_.LookupHash(hash);
+}
+
+bool BufferedBambooFilter::Writer::Delete(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    vector<uint64_t>::iterator it = std::find(buffer_.begin(), buffer_.end(), hash);
+    if (it != buffer_.end())
+    {
+        *it = buffer_.back();
+        buffer_.pop_back();
+        return true;
+    }
+    return filter_.DeleteHash(hash);
+}
+
+void BufferedBambooFilter::Writer::Flush()
+{
+    if (buffer_.empty())
+    {
+        return;
+    }
+    filter_.InsertBatch(&buffer_[0], buffer_.size());
+    buffer_.clear();
+}
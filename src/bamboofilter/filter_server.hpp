@@ -0,0 +1,613 @@
+// A BambooFilter served over a Unix domain socket, for processes that cannot
+// embed this header-only code.
+//
+// Protocol (little-endian, any number of requests in flight per connection,
+// answered in order):
+//
+//   request:  uint32 id | uint8 op (FilterOp) | uint8 0 | uint16 key length | key
+//   response: uint32 id | uint8 result (0 or 1, kResultBadRequest) | 3 x uint8 0
+//
+// Keys are hashed like BambooFilter::Insert(const char *) hashes a C string of
+// the same bytes, so a served filter and an embedded one agree.
+//
+// The server is one epoll loop. Each round reads whatever every ready
+// connection has sent, parses all complete requests into one batch, and runs
+// the batch in arrival order, prefetching the chains of the request
+// kPrefetchDistance ahead. Concurrent clients thus share batches and overlap
+// their cache misses, and no lock is needed.
+//
+// A connection whose unsent responses exceed kMaxBacklog bytes is not read
+// until they drain below it, so a client that sends without reading blocks
+// in write() instead of growing the server's buffers.
+//
+// Server and client send with MSG_NOSIGNAL, so a peer that hangs up is an
+// error on that connection, not a SIGPIPE for the host process.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+
+using std::vector;
+
+enum FilterOp
+{
+    kOpInsert = 1,
+    kOpLookup = 2,
+    kOpDelete = 3,
+    kOpInsertIfAbsent = 4,
+};
+
+static const uint32_t kRequestHeaderSize = 8;
+static const uint32_t kResponseSize = 8;
+static const uint8_t kResultBadRequest = 0xFF;
+
+class FilterServer
+{
+public:
+    static const uint32_t kPrefetchDistance = 8;
+    static const size_t kMaxBacklog = 256 << 10;
+
+    // Binds and listens on path, replacing a stale socket file.
+    FilterServer(const char *path, uint64_t capacity, uint32_t split_condition_param);
+    ~FilterServer();
+
+    // Serves until Stop().
+    void Run();
+
+    // Safe from other threads and from signal handlers.
+    void Stop()
+    {
+        stop_.store(true);
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    // Only while Run() is not running.
+    BambooFilter &Filter()
+    {
+        return filter_;
+    }
+
+    uint64_t NumBatches() const
+    {
+        return num_batches_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t NumRequests() const
+    {
+        return num_requests_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Connection
+    {
+        int fd;
+        bool closed;
+        // registered with epoll
+        uint32_t events;
+        vector<char> in;
+        size_t in_used;
+        vector<char> out;
+        size_t out_sent;
+    };
+
+    struct Request
+    {
+        Connection *conn;
+        uint32_t id;
+        uint8_t op;
+        uint64_t hash;
+    };
+
+    const std::string path_;
+    BambooFilter filter_;
+    int listen_fd_;
+    int epoll_fd_;
+    int wake_fd_;
+    std::atomic<bool> stop_;
+
+    std::unordered_set<Connection *> connections_;
+    vector<Request> batch_;
+    vector<Connection *> dirty_;
+    vector<Connection *> closing_;
+    // written by Run(), readable from any thread
+    std::atomic<uint64_t> num_batches_;
+    std::atomic<uint64_t> num_requests_;
+
+    void Accept();
+    void ReadFrom(Connection *conn);
+    void RunBatch();
+    void WriteTo(Connection *conn);
+    void UpdateEvents(Connection *conn);
+    void Close(Connection *conn);
+};
+
+FilterServer::FilterServer(const char *path, uint64_t capacity, uint32_t split_condition_param)
+    : path_(path), filter_(capacity, split_condition_param), stop_(false), num_batches_(0), num_requests_(0)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path))
+    {
+        throw std::invalid_argument("FilterServer: socket path too long");
+    }
+    strcpy(addr.sun_path, path);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+    {
+        throw std::runtime_error(std::string("socket: ") + strerror(errno));
+    }
+    unlink(path);
+    if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 128) != 0)
+    {
+        int err = errno;
+        close(listen_fd_);
+        throw std::runtime_error(std::string("bind ") + path + ": " + strerror(err));
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+    {
+        int err = errno;
+        close(listen_fd_);
+        unlink(path);
+        throw std::runtime_error(std::string("epoll_create1: ") + strerror(err));
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0)
+    {
+        int err = errno;
+        close(epoll_fd_);
+        close(listen_fd_);
+        unlink(path);
+        throw std::runtime_error(std::string("eventfd: ") + strerror(err));
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // the listening socket
+    int ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    if (ret == 0)
+    {
+        ev.data.ptr = &wake_fd_;
+        ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    }
+    if (ret != 0)
+    {
+        int err = errno;
+        close(wake_fd_);
+        close(epoll_fd_);
+        close(listen_fd_);
+        unlink(path);
+        throw std::runtime_error(std::string("epoll_ctl: ") + strerror(err));
+    }
+}
+
+FilterServer::~FilterServer()
+{
+    for (std::unordered_set<Connection *>::iterator it = connections_.begin(); it != connections_.end(); ++it)
+    {
+        close((*it)->fd);
+        delete *it;
+    }
+    close(epoll_fd_);
+    close(wake_fd_);
+    close(listen_fd_);
+    unlink(path_.c_str());
+}
+
+void FilterServer::Run()
+{
+    const int kMaxEvents = 256;
+    struct epoll_event events[kMaxEvents];
+
+    while (!stop_.load())
+    {
+        int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::runtime_error(std::string("epoll_wait: ") + strerror(errno));
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                Accept();
+                continue;
+            }
+            if (events[i].data.ptr == &wake_fd_)
+            {
+                continue;
+            }
+            Connection *conn = (Connection *)events[i].data.ptr;
+            // a hang-up fails the write of a backlog that stopped the reads
+            if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            {
+                WriteTo(conn);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                ReadFrom(conn);
+            }
+        }
+
+        RunBatch();
+
+        for (size_t i = 0; i < dirty_.size(); i++)
+        {
+            WriteTo(dirty_[i]);
+        }
+        dirty_.clear();
+        // connections go only after the batch that may still answer them
+        for (size_t i = 0; i < closing_.size(); i++)
+        {
+            close(closing_[i]->fd);
+            delete closing_[i];
+        }
+        closing_.clear();
+    }
+}
+
+void FilterServer::Accept()
+{
+    for (;;)
+    {
+        int fd = accept4(listen_fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        Connection *conn = new Connection();
+        conn->fd = fd;
+        conn->closed = false;
+        conn->events = EPOLLIN;
+        conn->in_used = 0;
+        conn->out_sent = 0;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            // out of epoll watches: refuse this client, keep serving the rest
+            close(fd);
+            delete conn;
+            continue;
+        }
+        connections_.insert(conn);
+    }
+}
+
+void FilterServer::ReadFrom(Connection *conn)
+{
+    static const size_t kReadSize = 64 << 10;
+    if (conn->closed)
+    {
+        return;
+    }
+    if (conn->out.size() - conn->out_sent > kMaxBacklog)
+    {
+        // the batch that just ran put it over: stop EPOLLIN until it drains
+        UpdateEvents(conn);
+        return;
+    }
+    if (conn->in.size() < conn->in_used + kReadSize)
+    {
+        conn->in.resize(conn->in_used + kReadSize);
+    }
+    ssize_t got = read(conn->fd, &conn->in[conn->in_used], kReadSize);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        Close(conn);
+        return;
+    }
+    if (got < 0)
+    {
+        return;
+    }
+    conn->in_used += got;
+
+    size_t pos = 0;
+    while (conn->in_used - pos >= kRequestHeaderSize)
+    {
+        const char *p = &conn->in[pos];
+        uint16_t key_len;
+        memcpy(&key_len, p + 6, sizeof(key_len));
+        if (conn->in_used - pos < kRequestHeaderSize + key_len)
+        {
+            break;
+        }
+        Request req;
+        req.conn = conn;
+        memcpy(&req.id, p, sizeof(req.id));
+        req.op = p[4];
+        req.hash = BambooFilter::HashKey(p + kRequestHeaderSize, key_len);
+        batch_.push_back(req);
+        pos += kRequestHeaderSize + key_len;
+    }
+    memmove(&conn->in[0], &conn->in[pos], conn->in_used - pos);
+    conn->in_used -= pos;
+}
+
+void FilterServer::RunBatch()
+{
+    const size_t n = batch_.size();
+    if (!n)
+    {
+        return;
+    }
+    for (size_t i = 0; i < kPrefetchDistance && i < n; i++)
+    {
+        filter_.PrefetchHash(batch_[i].hash);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i + kPrefetchDistance < n)
+        {
+            filter_.PrefetchHash(batch_[i + kPrefetchDistance].hash);
+        }
+        const Request &req = batch_[i];
+        uint8_t result;
+        switch (req.op)
+        {
+        case kOpInsert:
+            result = filter_.InsertHash(req.hash);
+            break;
+        case kOpLookup:
+            result = filter_.LookupHash(req.hash);
+            break;
+        case kOpDelete:
+            result = filter_.DeleteHash(req.hash);
+            break;
+        case kOpInsertIfAbsent:
+            result = filter_.InsertIfAbsentHash(req.hash);
+            break;
+        default:
+            result = kResultBadRequest;
+            break;
+        }
+        if (req.conn->closed)
+        {
+            continue;
+        }
+
+        char response[kResponseSize] = {0};
+        memcpy(response, &req.id, sizeof(req.id));
+        response[4] = result;
+        if (req.conn->out.size() == req.conn->out_sent)
+        {
+            dirty_.push_back(req.conn);
+        }
+        req.conn->out.insert(req.conn->out.end(), response, response + kResponseSize);
+    }
+    num_batches_.fetch_add(1, std::memory_order_relaxed);
+    num_requests_.fetch_add(n, std::memory_order_relaxed);
+    batch_.clear();
+}
+
+void FilterServer::WriteTo(Connection *conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    while (conn->out_sent < conn->out.size())
+    {
+        ssize_t sent = send(conn->fd, &conn->out[conn->out_sent], conn->out.size() - conn->out_sent, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN)
+            {
+                Close(conn);
+                return;
+            }
+            break;
+        }
+        conn->out_sent += sent;
+    }
+
+    if (conn->out_sent == conn->out.size())
+    {
+        conn->out.clear();
+        conn->out_sent = 0;
+    }
+    UpdateEvents(conn);
+}
+
+void FilterServer::UpdateEvents(Connection *conn)
+{
+    const size_t backlog = conn->out.size() - conn->out_sent;
+    // a full socket buffer: write the rest when epoll reports room, and stop
+    // reading requests while too many answers wait
+    uint32_t events = 0;
+    if (backlog <= kMaxBacklog)
+    {
+        events |= EPOLLIN;
+    }
+    if (backlog)
+    {
+        events |= EPOLLOUT;
+    }
+    if (events != conn->events)
+    {
+        conn->events = events;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn->fd, &ev) != 0)
+        {
+            Close(conn);
+        }
+    }
+}
+
+void FilterServer::Close(Connection *conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    conn->closed = true;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, NULL);
+    connections_.erase(conn);
+    closing_.push_back(conn);
+}
+
+// Blocking client for FilterServer. Send() only buffers, so a caller can put
+// many requests in flight and then collect the answers with Receive().
+class FilterClient
+{
+public:
+    explicit FilterClient(const char *path);
+    ~FilterClient()
+    {
+        close(fd_);
+    }
+
+    void Send(FilterOp op, uint32_t id, const char *key, uint16_t key_len);
+    void Flush();
+    // Next response, in request order.
+    void Receive(uint32_t &id, uint8_t &result);
+
+    // One request and its response.
+    bool Call(FilterOp op, const char *key)
+    {
+        uint32_t id;
+        uint8_t result;
+        Send(op, 0, key, strlen(key));
+        Flush();
+        Receive(id, result);
+        if (result == kResultBadRequest)
+        {
+            throw std::runtime_error("FilterClient: bad request");
+        }
+        return result;
+    }
+
+    bool Insert(const char *key)
+    {
+        return Call(kOpInsert, key);
+    }
+    bool Lookup(const char *key)
+    {
+        return Call(kOpLookup, key);
+    }
+    bool Delete(const char *key)
+    {
+        return Call(kOpDelete, key);
+    }
+    bool InsertIfAbsent(const char *key)
+    {
+        return Call(kOpInsertIfAbsent, key);
+    }
+
+private:
+    int fd_;
+    vector<char> out_;
+    char in_[4096];
+    size_t in_begin_, in_end_;
+};
+
+FilterClient::FilterClient(const char *path) : in_begin_(0), in_end_(0)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        throw std::invalid_argument("FilterClient: socket path too long");
+    }
+    strcpy(addr.sun_path, path);
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        int err = errno;
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+        throw std::runtime_error(std::string("connect ") + path + ": " + strerror(err));
+    }
+}
+
+void FilterClient::Send(FilterOp op, uint32_t id, const char *key, uint16_t key_len)
+{
+    char header[kRequestHeaderSize] = {0};
+    memcpy(header, &id, sizeof(id));
+    header[4] = op;
+    memcpy(header + 6, &key_len, sizeof(key_len));
+    out_.insert(out_.end(), header, header + kRequestHeaderSize);
+    out_.insert(out_.end(), key, key + key_len);
+}
+
+void FilterClient::Flush()
+{
+    size_t sent = 0;
+    while (sent < out_.size())
+    {
+        ssize_t n = send(fd_, &out_[sent], out_.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error(std::string("FilterClient: write: ") + strerror(errno));
+        }
+        sent += n;
+    }
+    out_.clear();
+}
+
+void FilterClient::Receive(uint32_t &id, uint8_t &result)
+{
+    while (in_end_ - in_begin_ < kResponseSize)
+    {
+        memmove(in_, in_ + in_begin_, in_end_ - in_begin_);
+        in_end_ -= in_begin_;
+        in_begin_ = 0;
+        ssize_t n = read(fd_, in_ + in_end_, sizeof(in_) - in_end_);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error("FilterClient: connection closed");
+        }
+        in_end_ += n;
+    }
+    memcpy(&id, in_ + in_begin_, sizeof(id));
+    result = in_[in_begin_ + 4];
+    in_begin_ += kResponseSize;
+}
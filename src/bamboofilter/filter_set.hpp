@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+
+using std::vector;
+
+// Probes up to 64 BambooFilters (e.g. one per run of an LSM tree) with a
+// single key. The key is hashed once. Each member derives its own segment,
+// chain and tag from that hash, since every member has its own
+// num_table_bits_. All candidate chains are prefetched before the first one
+// is compared, so the cache misses of the members overlap.
+//
+// Members are not owned and must outlive the set. They may change between
+// lookups, but not during one.
+class FilterSet
+{
+public:
+    static const uint32_t kMaxFilters = 64;
+
+    // Returns the member's bit in Lookup results.
+    uint32_t Add(const BambooFilter *filter)
+    {
+        if (filters_.size() >= kMaxFilters)
+        {
+            throw std::length_error("FilterSet: more than 64 filters");
+        }
+        filters_.push_back(filter);
+        return filters_.size() - 1;
+    }
+
+    void Clear()
+    {
+        filters_.clear();
+    }
+
+    uint32_t Size() const
+    {
+        return filters_.size();
+    }
+
+    // Bit i is set if member i may contain key.
+    uint64_t Lookup(const char *key) const
+    {
+        return LookupHash(BambooFilter::HashKey(key));
+    }
+
+    uint64_t LookupHash(uint64_t hash) const;
+
+private:
+    vector<const BambooFilter *> filters_;
+};
+
+uint64_t FilterSet::LookupHash(uint64_t hash) const
+{
+    const uint32_t n = filters_.size();
+    const Segment *segs[kMaxFilters];
+    uint32_t chain_idx[kMaxFilters];
+    uint32_t tags[kMaxFilters];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const BambooFilter *f = filters_[i];
+        if (f->short_tags_)
+        {
+            // over its memory budget; probed without prefetch below
+            segs[i] = NULL;
+            continue;
+        }
+        uint64_t seg_index;
+        BambooFilter::IndexTagFromHash(hash, f->INIT_TABLE_BITS, f->num_table_bits_, f->hash_table_.size(),
+                                       seg_index, chain_idx[i], tags[i]);
+        segs[i] = f->hash_table_[seg_index];
+        segs[i]->Prefetch(chain_idx[i], tags[i]);
+    }
+
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const bool found = segs[i] ? segs[i]->Lookup(chain_idx[i], tags[i]) : filters_[i]->LookupHash(hash);
+        mask |= (uint64_t)found << i;
+    }
+    return mask;
+}
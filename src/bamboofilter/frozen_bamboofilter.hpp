@@ -0,0 +1,277 @@
+// Immutable, read-only snapshot of a BambooFilter for filters that are built
+// once and then only queried.
+//
+// A live segment reserves chain_capacity buckets for every chain, plus
+// padding. Here each chain keeps only its non-empty tags, packed
+// back to back at 12-bit granularity. A per-segment table of 16-bit offsets
+// gives where each chain starts. The offsets and the tags of all segments share
+// one allocation. A lookup reads two offsets per candidate chain and then
+// compares 4 tags per 8-byte load. Answers are exactly those of the source filter.
+//
+// With semi_sorted, each chain is stored as groups of 4 tags in the 44-bit
+// semi-sorted encoding (semisort.h), followed by the last n % 4 tags in plain
+// 12 bits. Chain offsets then count nibbles instead of tags. This saves about 1
+// bit per key for one table lookup and two pdeps per group.
+
+#pragma once
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+#include "bamboofilter/semisort.h"
+
+class FrozenBambooFilter
+{
+public:
+    explicit FrozenBambooFilter(const BambooFilter &filter, bool semi_sorted = false);
+    ~FrozenBambooFilter();
+
+    bool Lookup(const char *key) const
+    {
+        return LookupHash(BambooFilter::HashKey(key));
+    }
+    bool LookupHash(uint64_t hash) const;
+
+    uint64_t NumItems() const
+    {
+        return num_items_;
+    }
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(FrozenBambooFilter) + block_size_;
+    }
+
+private:
+    static const uint32_t kChains = 1 << BUCKETS_PER_SEG;
+    static const uint32_t kOffsetsPerSeg = kChains + 1;
+    static const uint32_t kTagsPerLoad = 4;
+    // the second load of ScanChain reads 14 bytes past the chain start
+    static const uint32_t kLoadPad = 16;
+
+    const uint32_t init_table_bits_;
+    const uint32_t num_table_bits_;
+    const uint64_t num_segments_;
+    uint64_t num_items_;
+    const bool semi_sorted_;
+    const uint16_t *const semisort_table_;
+
+    // one block: seg_data_offset_[num_segments_], chain_offsets_[num_segments_][kOffsetsPerSeg], tags_
+    char *block_;
+    uint64_t block_size_;
+    uint64_t *seg_data_offset_;
+    uint16_t *chain_offsets_;
+    char *tags_;
+
+    static uint64_t LoadAt(const char *p, uint32_t nibble)
+    {
+        return *((const uint64_t *)(p + (nibble >> 1))) >> ((nibble & 1) << 2);
+    }
+
+    // v fits 60 bits and the block is zeroed, so a 64-bit or places it
+    static void StoreAt(char *p, uint32_t nibble, uint64_t v)
+    {
+        *((uint64_t *)(p + (nibble >> 1))) |= v << ((nibble & 1) << 2);
+    }
+
+    // Length of a chain of n tags in offset units.
+    uint32_t ChainUnits(uint32_t n) const
+    {
+        if (!semi_sorted_)
+        {
+            return n;
+        }
+        return n / SemiSortCodec::kTagsPerBucket * (SemiSortCodec::kBucketBits / 4) +
+               n % SemiSortCodec::kTagsPerBucket * (BITS_PER_TAG / 4);
+    }
+
+    static uint32_t GatherTags(const Segment *seg, uint32_t chain_idx, uint16_t *out)
+    {
+        const char *chain = seg->data_base + chain_idx * seg->chain_stride;
+        uint32_t n = 0;
+        for (uint32_t slot = 0; slot < seg->chain_capacity * Segment::kTagsPerBucket; slot++)
+        {
+            uint32_t tag = Segment::ReadTag(chain + slot / Segment::kTagsPerBucket * Segment::bucket_size,
+                                            slot % Segment::kTagsPerBucket);
+            if (tag)
+            {
+                out[n++] = tag;
+            }
+        }
+        return n;
+    }
+
+    static uint32_t Min4(uint32_t n)
+    {
+        return n < kTagsPerLoad ? n : kTagsPerLoad;
+    }
+
+    // Low n tags of v, at most 4; cleared lanes can only compare equal to tag 0,
+    // which is never stored.
+    static uint64_t Lanes(uint64_t v, uint32_t n)
+    {
+        return _bzhi_u64(v, BITS_PER_TAG * Min4(n));
+    }
+
+    // Tags [begin, end) of a plain segment. The first 8 tags take two loads and
+    // no branch; longer chains loop over the rest.
+    static bool ScanChain(const char *seg_tags, uint32_t begin, uint32_t end, uint32_t tag)
+    {
+        const uint32_t n = end - begin;
+        const char *p = seg_tags + begin + (begin >> 1);
+        const uint32_t shift = (begin & 1) << 2;
+        uint64_t v0 = Lanes(*((const uint64_t *)p) >> shift, n);
+        uint64_t v1 = Lanes(*((const uint64_t *)(p + 6)) >> shift, n > kTagsPerLoad ? n - kTagsPerLoad : 0);
+        bool found = (hasvalue12(v0, tag) | hasvalue12(v1, tag)) != 0;
+        for (uint32_t i = begin + 2 * kTagsPerLoad; i < end; i += kTagsPerLoad)
+        {
+            uint64_t v = *((const uint64_t *)(seg_tags + i + (i >> 1))) >> ((i & 1) << 2);
+            found |= hasvalue12(Lanes(v, end - i), tag) != 0;
+        }
+        return found;
+    }
+
+    // Nibbles [begin, end) of a semi-sorted segment: 11 per group of 4 tags,
+    // then 3 per remaining tag. The first group and the remainder are checked
+    // without branching; a chain of 8 or more tags loops over further groups.
+    bool ScanSemiSortedChain(const char *seg_tags, uint32_t begin, uint32_t end, uint32_t tag) const
+    {
+        // len % 11 -> number of plain tags at the end (len = 11 * groups + 3 * plain)
+        static const uint8_t kPlainTags[11] = {0, 0, 0, 1, 0, 0, 2, 0, 0, 3, 0};
+        const uint32_t len = end - begin;
+        const uint32_t plain = kPlainTags[len % 11];
+        const uint32_t groups = (len - 3 * plain) / 11;
+        // with no group the first decode reads plain tags or the next chain
+        // (SemiSortCodec::kTableSize covers any index) and is masked off
+        const uint64_t first_mask = -(uint64_t)(groups != 0);
+        bool found = hasvalue12(DecodeGroup(LoadAt(seg_tags, begin)) & first_mask, tag) != 0;
+        for (uint32_t g = 1; g < groups; g++)
+        {
+            found |= hasvalue12(DecodeGroup(LoadAt(seg_tags, begin + 11 * g)), tag) != 0;
+        }
+        found |= hasvalue12(_bzhi_u64(LoadAt(seg_tags, begin + 11 * groups), BITS_PER_TAG * plain), tag) != 0;
+        return found;
+    }
+
+    uint64_t DecodeGroup(uint64_t bits) const
+    {
+        return SemiSortCodec::Decode(bits, semisort_table_);
+    }
+};
+
+FrozenBambooFilter::FrozenBambooFilter(const BambooFilter &filter, bool semi_sorted)
+    : init_table_bits_(filter.INIT_TABLE_BITS),
+      num_table_bits_(filter.num_table_bits_),
+      num_segments_(filter.hash_table_.size()),
+      num_items_(filter.num_items_),
+      semi_sorted_(semi_sorted),
+      semisort_table_(SemiSortCodec::DecodeTable())
+{
+    if (filter.short_tags_)
+    {
+        throw std::invalid_argument("FrozenBambooFilter: filters with shortened tags are not supported");
+    }
+
+    const uint64_t index_size = num_segments_ * (sizeof(uint64_t) + kOffsetsPerSeg * sizeof(uint16_t));
+
+    uint32_t max_chain_tags = 0;
+    for (uint64_t s = 0; s < num_segments_; s++)
+    {
+        max_chain_tags = std::max(max_chain_tags, filter.hash_table_[s]->chain_capacity * Segment::kTagsPerBucket);
+    }
+    vector<uint16_t> chain_tags(max_chain_tags);
+
+    // first pass: the offset index
+    vector<uint16_t> offsets(num_segments_ * kOffsetsPerSeg);
+    vector<uint64_t> seg_offsets(num_segments_);
+    uint64_t tag_bytes = 0;
+    for (uint64_t s = 0; s < num_segments_; s++)
+    {
+        uint16_t *chain_offsets = &offsets[s * kOffsetsPerSeg];
+        uint32_t len = 0;
+        for (uint32_t c = 0; c < kChains; c++)
+        {
+            chain_offsets[c] = len;
+            len += ChainUnits(GatherTags(filter.hash_table_[s], c, &chain_tags[0]));
+        }
+        if (len > 0xFFFF)
+        {
+            throw std::length_error("FrozenBambooFilter: segment too large for 16-bit chain offsets");
+        }
+        chain_offsets[kChains] = len;
+        seg_offsets[s] = tag_bytes;
+        // segments start on a byte boundary
+        tag_bytes += semi_sorted_ ? (len + 1) / 2 : (len + (len & 1)) * BITS_PER_TAG / 8;
+    }
+
+    block_size_ = index_size + tag_bytes + kLoadPad;
+    void *p;
+    if (posix_memalign(&p, 64, block_size_))
+    {
+        throw std::bad_alloc();
+    }
+    block_ = (char *)p;
+    memset(block_, 0, block_size_);
+    seg_data_offset_ = (uint64_t *)block_;
+    chain_offsets_ = (uint16_t *)(block_ + num_segments_ * sizeof(uint64_t));
+    tags_ = block_ + index_size;
+    memcpy(seg_data_offset_, &seg_offsets[0], num_segments_ * sizeof(uint64_t));
+    memcpy(chain_offsets_, &offsets[0], num_segments_ * kOffsetsPerSeg * sizeof(uint16_t));
+
+    // second pass: pack the tags; nibble offsets, as 12 bits are 3 nibbles
+    for (uint64_t s = 0; s < num_segments_; s++)
+    {
+        char *seg_tags = tags_ + seg_data_offset_[s];
+        uint32_t pos = 0;
+        for (uint32_t c = 0; c < kChains; c++)
+        {
+            const uint32_t n = GatherTags(filter.hash_table_[s], c, &chain_tags[0]);
+            uint32_t i = 0;
+            if (semi_sorted_)
+            {
+                for (; i + SemiSortCodec::kTagsPerBucket <= n; i += SemiSortCodec::kTagsPerBucket)
+                {
+                    StoreAt(seg_tags, pos, SemiSortCodec::Encode(&chain_tags[i]));
+                    pos += SemiSortCodec::kBucketBits / 4;
+                }
+            }
+            for (; i < n; i++)
+            {
+                StoreAt(seg_tags, pos, chain_tags[i]);
+                pos += BITS_PER_TAG / 4;
+            }
+        }
+    }
+}
+
+FrozenBambooFilter::~FrozenBambooFilter()
+{
+    free(block_);
+}
+
+bool FrozenBambooFilter::LookupHash(uint64_t hash) const
+{
+    uint64_t seg_index;
+    uint32_t chain_idx, tag;
+    BambooFilter::IndexTagFromHash(hash, init_table_bits_, num_table_bits_, num_segments_, seg_index, chain_idx, tag);
+
+    const uint16_t *offsets = chain_offsets_ + seg_index * kOffsetsPerSeg;
+    const char *seg_tags = tags_ + seg_data_offset_[seg_index];
+    const uint32_t alt_idx = Segment::AltIndex(chain_idx, tag);
+    if (semi_sorted_)
+    {
+        return ScanSemiSortedChain(seg_tags, offsets[chain_idx], offsets[chain_idx + 1], tag) |
+               ScanSemiSortedChain(seg_tags, offsets[alt_idx], offsets[alt_idx + 1], tag);
+    }
+    return ScanChain(seg_tags, offsets[chain_idx], offsets[chain_idx + 1], tag) |
+           ScanChain(seg_tags, offsets[alt_idx], offsets[alt_idx + 1], tag);
+}
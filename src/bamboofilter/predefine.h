@@ -1,3 +1,5 @@
+#pragma once
+
 #define BUCKETS_PER_SEG 10
 #define MAX_CUCKOO_KICK 8
 
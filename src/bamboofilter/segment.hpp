@@ -1,16 +1,38 @@
+#pragma once
+
 #include <immintrin.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 #include <iostream>
+#include <vector>
 
 #include "bamboofilter/bitsutil.h"
 #include "bamboofilter/predefine.h"
 
 using namespace std;
 
+// Backing storage for segment chain data that lives outside the process heap,
+// e.g. in a shared-memory region. Blocks must be 64-byte aligned.
+class SegmentArena
+{
+public:
+    virtual ~SegmentArena() {}
+    virtual char *Alloc(uint32_t size) = 0;
+    virtual void Free(char *p, uint32_t size) = 0;
+};
+
+template <uint32_t kValueBits>
+class MapSegment;
+class FrozenBambooFilter;
+
 class Segment
 {
+    // shares the tag packing and split helpers below
+    template <uint32_t kValueBits>
+    friend class MapSegment;
+    friend class FrozenBambooFilter;
+
 private:
     // const
     static const uint32_t kTagsPerBucket = 4;
@@ -22,15 +44,75 @@ private:
     static const uint32_t bucket_size = (BITS_PER_TAG * kTagsPerBucket + 7) / 8; // kBytesPerBucket
     static const uint32_t safe_pad = sizeof(uint64_t) - bucket_size;
     static const uint32_t safe_pad_simd = 4; // 4B for avx2
+    static const uint32_t kCacheLineSize = 64;
 
 private:
-    char *temp;
     const uint32_t chain_num;
+    const bool cache_aligned;
+    SegmentArena *const arena;
     uint32_t chain_capacity;
+    uint32_t chain_stride;
     uint32_t total_size;
     uint32_t insert_cur;
     char *data_base;
-    uint32_t ANS_MASK;
+
+    // Bytes between the starts of two consecutive chains. The packed layout puts
+    // chains back to back; the cache-aligned layout rounds a chain (plus the tail of
+    // the 8-byte load on its last bucket) up to a power of two that divides a cache
+    // line, or to whole lines, so a chain never straddles two lines.
+    uint32_t ChainStride(uint32_t capacity) const
+    {
+        uint32_t len = capacity * bucket_size;
+        if (!cache_aligned)
+        {
+            return len;
+        }
+        len += safe_pad;
+        if (len <= kCacheLineSize)
+        {
+            return upperpower2(len);
+        }
+        return (len + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+    }
+
+    uint32_t DataSize(uint32_t stride) const
+    {
+        return chain_num * stride + (cache_aligned ? 0 : safe_pad);
+    }
+
+    char *AllocData(uint32_t size) const
+    {
+        if (arena)
+        {
+            return arena->Alloc(size);
+        }
+        if (!cache_aligned)
+        {
+            return new char[size];
+        }
+        void *p;
+        if (posix_memalign(&p, kCacheLineSize, size))
+        {
+            throw bad_alloc();
+        }
+        return (char *)p;
+    }
+
+    void FreeData(char *p, uint32_t size) const
+    {
+        if (arena)
+        {
+            arena->Free(p, size);
+        }
+        else if (cache_aligned)
+        {
+            free(p);
+        }
+        else
+        {
+            delete[] p;
+        }
+    }
 
     static uint32_t IndexHash(uint32_t index)
     {
@@ -126,95 +208,75 @@ private:
         return _mm256_blend_epi16(lo, hi, 0b10101010);
     }
 
-public:
-    Segment(const uint32_t chain_num)
-        : chain_num(chain_num),
-          chain_capacity(1),
-          insert_cur(0),
-          ANS_MASK(~(0xFFFFFFFF << 2 * (2 * chain_capacity * kTagsPerBucket % 16)))
+    // Unpacks four buckets (one per 64-bit lane) into 16 tags. Each bucket is read
+    // with a plain 8-byte load, the same as LookupTag; the two trailing bytes belong
+    // to the next bucket, safe_pad or chain padding and are dropped by the shuffle.
+    static __m256i unpack4Buckets(const char *b0, const char *b1, const char *b2, const char *b3)
     {
-        total_size = chain_num * chain_capacity * bucket_size + safe_pad;
-        data_base = new char[total_size];
-        memset(data_base, 0, (chain_num * chain_capacity * bucket_size));
-        temp = new char[safe_pad_simd + (2 * chain_capacity * bucket_size + 23) / 24 * 24 + safe_pad_simd];
-    }
+        __m256i v = _mm256_set_epi64x(*((const uint64_t *)b3), *((const uint64_t *)b2),
+                                      *((const uint64_t *)b1), *((const uint64_t *)b0));
 
-    Segment(const Segment &s)
-        : chain_num(s.chain_num),
-          chain_capacity(s.chain_capacity),
-          total_size(s.total_size),
-          insert_cur(0),
-          ANS_MASK(s.ANS_MASK)
-    {
-        data_base = new char[total_size];
-        temp = new char[safe_pad_simd + (2 * chain_capacity * bucket_size + 23) / 24 * 24 + safe_pad_simd];
-        memcpy(data_base, s.data_base, total_size);
+        const __m256i bytegrouping =
+            _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 8, 9, 9, 10, 11, 12, 12, 13,
+                             0, 1, 1, 2, 3, 4, 4, 5, 8, 9, 9, 10, 11, 12, 12, 13);
+        v = _mm256_shuffle_epi8(v, bytegrouping);
+
+        __m256i hi = _mm256_srli_epi16(v, 4);
+        __m256i lo = _mm256_and_si256(v, _mm256_set1_epi32(0x00000FFF));
+
+        return _mm256_blend_epi16(lo, hi, 0b10101010);
     }
 
-    ~Segment()
+    // Lookup kernel for a fixed chain capacity: reads both chains in place (no copy
+    // into scratch), unrolls into 2 * kCap / 4 vector compares and tests a single mask.
+    // For odd kCap the last two buckets fill both lanes, so no tail mask is needed.
+    template <uint32_t kCap>
+    static bool LookupShortChain(const char *data_base, uint32_t chain_stride, uint32_t chain_idx, uint16_t tag)
     {
-        delete[] data_base;
-        delete[] temp;
-    };
+        const uint32_t kBuckets = 2 * kCap;
+        const char *p1 = data_base + chain_idx * chain_stride;
+        const char *p2 = data_base + AltIndex(chain_idx, tag) * chain_stride;
 
-    bool Insert(uint32_t chain_idx, uint32_t curtag)
-    {
-        char *bucket_p;
-        for (uint32_t count = 0; count < MAX_CUCKOO_KICK; count++)
+        const char *b[kBuckets];
+        for (uint32_t i = 0; i < kCap; i++)
         {
-            bucket_p = data_base + (chain_idx * chain_capacity + insert_cur) * bucket_size;
-            bool kickout = count > 0;
-
-            for (size_t tag_idx = 0; tag_idx < kTagsPerBucket; tag_idx++)
-            {
-                if (0 == ReadTag(bucket_p, tag_idx))
-                {
-                    WriteTag(bucket_p, tag_idx, curtag);
-                    return true;
-                }
-            }
-
-            if (kickout)
-            {
-                size_t tag_idx = rand() % kTagsPerBucket;
-                uint32_t oldtag = ReadTag(bucket_p, tag_idx);
-                WriteTag(bucket_p, tag_idx, curtag);
-                curtag = oldtag;
-            }
-            chain_idx = AltIndex(chain_idx, curtag);
-            bucket_p = data_base + (chain_idx * chain_capacity + insert_cur) * bucket_size;
+            b[i] = p1 + i * bucket_size;
+            b[kCap + i] = p2 + i * bucket_size;
         }
 
-        insert_cur++;
-        if (insert_cur >= chain_capacity)
+        __m256i _true_tag = _mm256_set1_epi16(tag);
+        __m256i _ans = _mm256_setzero_si256();
+        for (uint32_t i = 0; i + 4 <= kBuckets; i += 4)
         {
-            char *old_data_base = data_base;
-            uint32_t old_chain_len = chain_capacity * bucket_size;
-            chain_capacity++;
-            uint32_t new_chain_len = chain_capacity * bucket_size;
-            ANS_MASK = ~(0xFFFFFFFF << 2 * (2 * chain_capacity * kTagsPerBucket % 16));
-            delete[] temp;
-            temp = new char[safe_pad_simd + (2 * chain_capacity * bucket_size + 23) / 24 * 24 + safe_pad_simd];
-
-            total_size = chain_num * chain_capacity * bucket_size + safe_pad;
-            data_base = new char[total_size];
-            memset(data_base, 0, total_size);
-            for (int i = 0; i < chain_num; i++)
-            {
-                memcpy(data_base + i * new_chain_len, old_data_base + i * old_chain_len, old_chain_len);
-            }
-            delete[] old_data_base;
+            __m256i _16_tags = unpack4Buckets(b[i], b[i + 1], b[i + 2], b[i + 3]);
+            _ans = _mm256_or_si256(_ans, _mm256_cmpeq_epi16(_16_tags, _true_tag));
         }
-        return Insert(chain_idx, curtag);
+        if (kBuckets % 4)
+        {
+            __m256i _16_tags = unpack4Buckets(b[kBuckets - 2], b[kBuckets - 1], b[kBuckets - 2], b[kBuckets - 1]);
+            _ans = _mm256_or_si256(_ans, _mm256_cmpeq_epi16(_16_tags, _true_tag));
+        }
+        return _mm256_movemask_epi8(_ans);
     }
 
-    bool Lookup(uint32_t chain_idx, uint16_t tag) const
+    // Copies both chains back to back into a scratch buffer of the calling
+    // thread, so concurrent readers of one segment never share it.
+    static bool LookupLongChain(const char *data_base, uint32_t chain_capacity, uint32_t chain_stride,
+                                uint32_t chain_idx, uint16_t tag)
     {
+        static thread_local vector<char> scratch;
+        if (scratch.size() < TempSize(chain_capacity))
+        {
+            scratch.resize(TempSize(chain_capacity));
+        }
+        char *temp = scratch.data();
+        const uint32_t ans_mask = ~(0xFFFFFFFF << 2 * (2 * chain_capacity * kTagsPerBucket % 16));
+
         memcpy(temp + safe_pad_simd,
-               data_base + chain_idx * chain_capacity * bucket_size,
+               data_base + chain_idx * chain_stride,
                chain_capacity * bucket_size);
         memcpy(temp + safe_pad_simd + chain_capacity * bucket_size,
-               data_base + AltIndex(chain_idx, tag) * chain_capacity * bucket_size,
+               data_base + AltIndex(chain_idx, tag) * chain_stride,
                chain_capacity * bucket_size);
         char *p = temp + safe_pad_simd;
         char *end = p + 2 * chain_capacity * bucket_size;
@@ -234,19 +296,281 @@ public:
         __m256i _16_tags = unpack12to16(p);
 
         __m256i _ans = _mm256_cmpeq_epi16(_16_tags, _true_tag);
-        if (ANS_MASK & _mm256_movemask_epi8(_ans))
+        if (ans_mask & _mm256_movemask_epi8(_ans))
         {
             return true;
         }
         return false;
     }
 
+    // InsertIfAbsent's scan of both chains: kFoundTag if a slot holds tag, else
+    // the first empty slot as bucket * kTagsPerBucket + slot, counting the
+    // chain_idx chain's buckets first, or kNoEmptySlot.
+    static const int kFoundTag = -1;
+    static const int kNoEmptySlot = -2;
+
+    // One pass of the short-chain lookup kernel that also collects empty lanes.
+    template <uint32_t kCap>
+    static int FindTagOrEmptyShortChain(const char *p1, const char *p2, uint16_t tag)
+    {
+        const uint32_t kBuckets = 2 * kCap;
+        const char *b[kBuckets];
+        for (uint32_t i = 0; i < kCap; i++)
+        {
+            b[i] = p1 + i * bucket_size;
+            b[kCap + i] = p2 + i * bucket_size;
+        }
+
+        __m256i _true_tag = _mm256_set1_epi16(tag);
+        __m256i _ans = _mm256_setzero_si256();
+        uint64_t empty = 0;
+        for (uint32_t i = 0; i + 4 <= kBuckets; i += 4)
+        {
+            __m256i _16_tags = unpack4Buckets(b[i], b[i + 1], b[i + 2], b[i + 3]);
+            _ans = _mm256_or_si256(_ans, _mm256_cmpeq_epi16(_16_tags, _true_tag));
+            empty |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_16_tags, _mm256_setzero_si256())) << (8 * i);
+        }
+        if (kBuckets % 4)
+        {
+            // the upper two lanes repeat the last two buckets
+            __m256i _16_tags = unpack4Buckets(b[kBuckets - 2], b[kBuckets - 1], b[kBuckets - 2], b[kBuckets - 1]);
+            _ans = _mm256_or_si256(_ans, _mm256_cmpeq_epi16(_16_tags, _true_tag));
+            empty |= (uint64_t)(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_16_tags, _mm256_setzero_si256())) & 0xFFFF)
+                     << (8 * (kBuckets - 2));
+        }
+        if (_mm256_movemask_epi8(_ans))
+        {
+            return kFoundTag;
+        }
+        // two mask bits per 16-bit lane, one lane per slot
+        return empty ? (int)(__builtin_ctzll(empty) >> 1) : kNoEmptySlot;
+    }
+
+    int FindTagOrEmptyLongChain(const char *p1, const char *p2, uint16_t tag) const
+    {
+        int first_empty = kNoEmptySlot;
+        for (uint32_t i = 0; i < 2 * chain_capacity; i++)
+        {
+            const char *p = i < chain_capacity ? p1 + i * bucket_size : p2 + (i - chain_capacity) * bucket_size;
+            const uint64_t v = *((const uint64_t *)p) & kBucketMask;
+            if (hasvalue12(v, tag))
+            {
+                return kFoundTag;
+            }
+            if (first_empty == kNoEmptySlot && haszero12(v))
+            {
+                uint32_t slot = 0;
+                while (ReadTag(p, slot))
+                {
+                    slot++;
+                }
+                first_empty = i * kTagsPerBucket + slot;
+            }
+        }
+        return first_empty;
+    }
+
+public:
+    Segment(const uint32_t chain_num, const bool cache_aligned = false, SegmentArena *arena = NULL)
+        : chain_num(chain_num),
+          cache_aligned(cache_aligned),
+          arena(arena),
+          chain_capacity(1),
+          insert_cur(0)
+    {
+        chain_stride = ChainStride(chain_capacity);
+        total_size = DataSize(chain_stride);
+        data_base = AllocData(total_size);
+        memset(data_base, 0, total_size);
+    }
+
+    Segment(const Segment &s)
+        : chain_num(s.chain_num),
+          cache_aligned(s.cache_aligned),
+          arena(s.arena),
+          chain_capacity(s.chain_capacity),
+          chain_stride(s.chain_stride),
+          total_size(s.total_size),
+          insert_cur(0)
+    {
+        data_base = AllocData(total_size);
+        memcpy(data_base, s.data_base, total_size);
+    }
+
+    ~Segment()
+    {
+        FreeData(data_base, total_size);
+    };
+
+    static uint32_t BucketBytes()
+    {
+        return bucket_size;
+    }
+
+    // Scratch bytes LookupLongChain needs for chains of chain_capacity buckets.
+    static uint32_t TempSize(uint32_t chain_capacity)
+    {
+        return safe_pad_simd + (2 * chain_capacity * bucket_size + 23) / 24 * 24 + safe_pad_simd;
+    }
+
+    // Lookup over raw chain data, so that read-only views of a segment (e.g. one
+    // mapped from shared memory) use the same kernels as Segment::Lookup.
+    static bool LookupChains(const char *data_base, uint32_t chain_capacity, uint32_t chain_stride,
+                             uint32_t chain_idx, uint16_t tag)
+    {
+        switch (chain_capacity)
+        {
+        case 1:
+            return LookupShortChain<1>(data_base, chain_stride, chain_idx, tag);
+        case 2:
+            return LookupShortChain<2>(data_base, chain_stride, chain_idx, tag);
+        case 3:
+            return LookupShortChain<3>(data_base, chain_stride, chain_idx, tag);
+        case 4:
+            return LookupShortChain<4>(data_base, chain_stride, chain_idx, tag);
+        default:
+            return LookupLongChain(data_base, chain_capacity, chain_stride, chain_idx, tag);
+        }
+    }
+
+    // Throws when the chains must grow and the allocation fails; every tag the
+    // kicks moved is then back where it was, and curtag is not stored.
+    bool Insert(uint32_t chain_idx, uint32_t curtag)
+    {
+        // slots overwritten by kicks and what they held, so a failed growth can
+        // put back the tags displaced in every round, oldest last
+        struct Kick
+        {
+            uint32_t chain_idx, bucket, tag_idx, tag;
+        };
+        static thread_local vector<Kick> kicks;
+        kicks.clear();
+
+        for (;;)
+        {
+            char *bucket_p;
+            for (uint32_t count = 0; count < MAX_CUCKOO_KICK; count++)
+            {
+                bucket_p = data_base + chain_idx * chain_stride + insert_cur * bucket_size;
+                bool kickout = count > 0;
+
+                for (size_t tag_idx = 0; tag_idx < kTagsPerBucket; tag_idx++)
+                {
+                    if (0 == ReadTag(bucket_p, tag_idx))
+                    {
+                        WriteTag(bucket_p, tag_idx, curtag);
+                        return true;
+                    }
+                }
+
+                if (kickout)
+                {
+                    size_t tag_idx = rand() % kTagsPerBucket;
+                    uint32_t oldtag = ReadTag(bucket_p, tag_idx);
+                    WriteTag(bucket_p, tag_idx, curtag);
+                    kicks.push_back({chain_idx, insert_cur, (uint32_t)tag_idx, oldtag});
+                    curtag = oldtag;
+                }
+                chain_idx = AltIndex(chain_idx, curtag);
+                bucket_p = data_base + chain_idx * chain_stride + insert_cur * bucket_size;
+            }
+
+            // Growth allocates before it changes any member, so a bad_alloc
+            // leaves the layout as it was.
+            if (insert_cur + 1 >= chain_capacity)
+            {
+                const uint32_t new_capacity = chain_capacity + 1;
+                const uint32_t new_stride = ChainStride(new_capacity);
+                const uint32_t new_total_size = DataSize(new_stride);
+                char *new_data_base;
+                try
+                {
+                    new_data_base = AllocData(new_total_size);
+                }
+                catch (...)
+                {
+                    for (size_t k = kicks.size(); k-- > 0;)
+                    {
+                        WriteTag(data_base + kicks[k].chain_idx * chain_stride + kicks[k].bucket * bucket_size,
+                                 kicks[k].tag_idx, kicks[k].tag);
+                    }
+                    throw;
+                }
+                memset(new_data_base, 0, new_total_size);
+                for (int i = 0; i < chain_num; i++)
+                {
+                    memcpy(new_data_base + i * new_stride, data_base + i * chain_stride, chain_capacity * bucket_size);
+                }
+                FreeData(data_base, total_size);
+                data_base = new_data_base;
+                total_size = new_total_size;
+                chain_capacity = new_capacity;
+                chain_stride = new_stride;
+            }
+            insert_cur++;
+        }
+    }
+
+    // Inserts tag unless one of its two chains already holds it, and returns
+    // whether it did. A single scan of both chains looks for the tag and for a
+    // free slot at the same time; only when both chains are full does it fall
+    // back to Insert's kicks.
+    bool InsertIfAbsent(uint32_t chain_idx, uint32_t tag)
+    {
+        char *p1 = data_base + chain_idx * chain_stride;
+        char *p2 = data_base + AltIndex(chain_idx, tag) * chain_stride;
+        int slot;
+        switch (chain_capacity)
+        {
+        case 1:
+            slot = FindTagOrEmptyShortChain<1>(p1, p2, tag);
+            break;
+        case 2:
+            slot = FindTagOrEmptyShortChain<2>(p1, p2, tag);
+            break;
+        case 3:
+            slot = FindTagOrEmptyShortChain<3>(p1, p2, tag);
+            break;
+        case 4:
+            slot = FindTagOrEmptyShortChain<4>(p1, p2, tag);
+            break;
+        default:
+            slot = FindTagOrEmptyLongChain(p1, p2, tag);
+            break;
+        }
+
+        if (slot == kFoundTag)
+        {
+            return false;
+        }
+        if (slot == kNoEmptySlot)
+        {
+            return Insert(chain_idx, tag);
+        }
+        const uint32_t bucket = slot / kTagsPerBucket;
+        char *p = bucket < chain_capacity ? p1 + bucket * bucket_size : p2 + (bucket - chain_capacity) * bucket_size;
+        WriteTag(p, slot % kTagsPerBucket, tag);
+        return true;
+    }
+
+    bool Lookup(uint32_t chain_idx, uint16_t tag) const
+    {
+        return LookupChains(data_base, chain_capacity, chain_stride, chain_idx, tag);
+    }
+
+    // Starts loading the first cache line of both candidate chains of a Lookup.
+    void Prefetch(uint32_t chain_idx, uint16_t tag) const
+    {
+        _mm_prefetch(data_base + chain_idx * chain_stride, _MM_HINT_T0);
+        _mm_prefetch(data_base + AltIndex(chain_idx, tag) * chain_stride, _MM_HINT_T0);
+    }
+
     bool Delete(uint32_t chain_idx, uint32_t tag)
     {
         uint32_t chain_idx2 = AltIndex(chain_idx, tag);
         for (int i = 0; i < chain_capacity; i++)
         {
-            char *p = data_base + (chain_idx * chain_capacity + i) * bucket_size;
+            char *p = data_base + chain_idx * chain_stride + i * bucket_size;
             if (DeleteTag(p, tag))
             {
                 return true;
@@ -254,7 +578,7 @@ public:
         }
         for (int i = 0; i < chain_capacity; i++)
         {
-            char *p = data_base + (chain_idx2 * chain_capacity + i) * bucket_size;
+            char *p = data_base + chain_idx2 * chain_stride + i * bucket_size;
             if (DeleteTag(p, tag))
             {
                 return true;
@@ -265,10 +589,13 @@ public:
 
     void EraseEle(bool is_src, uint32_t actv_bit)
     {
-        for (int i = 0; i < chain_num * chain_capacity; i++)
+        for (int i = 0; i < chain_num; i++)
         {
-            char *p = data_base + i * bucket_size;
-            doErase(p, is_src, actv_bit);
+            for (int j = 0; j < chain_capacity; j++)
+            {
+                char *p = data_base + i * chain_stride + j * bucket_size;
+                doErase(p, is_src, actv_bit);
+            }
         }
         insert_cur = 0;
     }
@@ -276,24 +603,126 @@ public:
     void Absorb(const Segment *segment)
     {
         char *p1 = data_base;
+        uint32_t size1 = total_size;
         uint32_t len1 = (chain_capacity * bucket_size);
+        uint32_t stride1 = chain_stride;
         char *p2 = segment->data_base;
         uint32_t len2 = (segment->chain_capacity * segment->bucket_size);
-
-        chain_capacity += segment->chain_capacity;
+        uint32_t stride2 = segment->chain_stride;
+
+        const uint32_t new_capacity = chain_capacity + segment->chain_capacity;
+        const uint32_t new_stride = ChainStride(new_capacity);
+        const uint32_t new_total_size = DataSize(new_stride);
+        data_base = AllocData(new_total_size);
+        memset(data_base, 0, new_total_size);
+        chain_capacity = new_capacity;
+        chain_stride = new_stride;
+        total_size = new_total_size;
         insert_cur = 0;
-        ANS_MASK = ~(0xFFFFFFFF << 2 * (2 * chain_capacity * kTagsPerBucket % 16));
 
-        total_size = chain_num * chain_capacity * bucket_size + safe_pad;
-        data_base = new char[total_size];
+        for (int i = 0; i < chain_num; i++)
+        {
+            memcpy(data_base + i * chain_stride, p1 + i * stride1, len1);
+            memcpy(data_base + i * chain_stride + len1, p2 + i * stride2, len2);
+        }
+        FreeData(p1, size1);
+    }
+
+    // Moves every chain's tags into its leading buckets and shrinks chain_capacity
+    // to the fullest chain. Tags never leave their chain, so both candidate chains
+    // of every key stay the same; only the slack left by splits and deletes goes.
+    void Compact()
+    {
+        uint32_t max_tags = 0;
+        for (int i = 0; i < chain_num; i++)
+        {
+            uint32_t num_tags = 0;
+            for (uint32_t slot = 0; slot < chain_capacity * kTagsPerBucket; slot++)
+            {
+                num_tags += ReadTag(data_base + i * chain_stride + slot / kTagsPerBucket * bucket_size, slot % kTagsPerBucket) != 0;
+            }
+            max_tags = max_tags > num_tags ? max_tags : num_tags;
+        }
+        uint32_t new_capacity = (max_tags + kTagsPerBucket - 1) / kTagsPerBucket;
+        new_capacity = new_capacity ? new_capacity : 1;
+        if (new_capacity >= chain_capacity)
+        {
+            return;
+        }
 
+        char *old_data_base = data_base;
+        uint32_t old_total_size = total_size;
+        uint32_t old_capacity = chain_capacity;
+        uint32_t old_chain_stride = chain_stride;
+        const uint32_t new_stride = ChainStride(new_capacity);
+        const uint32_t new_total_size = DataSize(new_stride);
+        data_base = AllocData(new_total_size);
+        memset(data_base, 0, new_total_size);
+        chain_capacity = new_capacity;
+        chain_stride = new_stride;
+        total_size = new_total_size;
         for (int i = 0; i < chain_num; i++)
         {
-            memcpy(data_base + i * (len1 + len2), p1 + i * len1, len1);
-            memcpy(data_base + i * (len1 + len2) + len1, p2 + i * len2, len2);
+            uint32_t cur = 0;
+            for (uint32_t slot = 0; slot < old_capacity * kTagsPerBucket; slot++)
+            {
+                uint32_t tag = ReadTag(old_data_base + i * old_chain_stride + slot / kTagsPerBucket * bucket_size, slot % kTagsPerBucket);
+                if (tag)
+                {
+                    WriteTag(data_base + i * chain_stride + cur / kTagsPerBucket * bucket_size, cur % kTagsPerBucket, tag);
+                    cur++;
+                }
+            }
+        }
+        FreeData(old_data_base, old_total_size);
+        insert_cur = 0;
+    }
+
+    // Calls f(chain_idx, tag) for every stored tag.
+    template <typename F>
+    void ForEachTag(F f) const
+    {
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            for (uint32_t slot = 0; slot < chain_capacity * kTagsPerBucket; slot++)
+            {
+                uint32_t tag = ReadTag(data_base + i * chain_stride + slot / kTagsPerBucket * bucket_size, slot % kTagsPerBucket);
+                if (tag)
+                {
+                    f(i, tag);
+                }
+            }
         }
-        delete[] p1;
-        delete[] temp;
-        temp = new char[safe_pad_simd + (2 * chain_capacity * bucket_size + 23) / 24 * 24 + safe_pad_simd];
+    }
+
+    uint32_t ChainCapacity() const
+    {
+        return chain_capacity;
+    }
+
+    const char *Data() const
+    {
+        return data_base;
+    }
+
+    uint32_t Stride() const
+    {
+        return chain_stride;
+    }
+
+    uint32_t DataBytes() const
+    {
+        return total_size;
+    }
+
+    // Longest chain served by a LookupShortChain kernel.
+    static bool IsShortChain(uint32_t capacity)
+    {
+        return capacity <= 4;
+    }
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(Segment) + total_size;
     }
 };
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "bamboofilter/predefine.h"
+
+// Semi-sorted encoding of 4 12-bit tags (Fan et al., "Cuckoo Filter: Practically
+// Better Than Bloom", CoNEXT 2014). The order of the tags in a bucket carries
+// no information, so the tags are sorted by their top nibble. The 4 sorted
+// nibbles are one of only 3876 combinations and fit a 12-bit index instead of
+// 16 bits. A bucket takes 44 bits instead of 48:
+//
+//   bits  0..11  index of the sorted top nibbles in the decode table
+//   bits 12..43  low 8 bits of the 4 tags, in sorted order
+//
+// Decode() deposits the fields back into the plain packing of a Segment bucket
+// (4 x 12 bits), so the usual hasvalue12 compare runs on the result.
+//
+// Only FrozenBambooFilter stores buckets this way. A live Segment rewrites
+// single slots in place (inserts, every cuckoo kick, deletes) and masks whole
+// 64-bit words on a split, all on byte-aligned 6-byte buckets that the lookup
+// kernels load 8 bytes at a time. 44-bit buckets would turn each of those
+// writes into a decode, modify and re-encode with a binary search, and move
+// every bucket off byte boundaries, to save 4 bits per bucket.
+class SemiSortCodec
+{
+public:
+    static const uint32_t kTagsPerBucket = 4;
+    static const uint32_t kBucketBits = 44;
+    static const uint32_t kNumCodes = 3876;
+    // Decode accepts any 12-bit index; the codes past kNumCodes decode to
+    // zero nibbles, so callers may decode bits that are not a group and mask
+    // the result instead of branching.
+    static const uint32_t kTableSize = 1 << 12;
+
+    static_assert(BITS_PER_TAG == 12, "the semi-sorted layout assumes 12-bit tags");
+
+    // tags are sorted in place; 0 is a valid (empty) tag
+    static uint64_t Encode(uint16_t tags[kTagsPerBucket])
+    {
+        std::sort(tags, tags + kTagsPerBucket, HighNibbleLess);
+        uint16_t nibbles = 0;
+        uint64_t lows = 0;
+        for (uint32_t i = 0; i < kTagsPerBucket; i++)
+        {
+            nibbles |= (tags[i] >> 8) << (4 * i);
+            lows |= (uint64_t)(tags[i] & 0xFF) << (8 * i);
+        }
+        const uint16_t *table = DecodeTable();
+        uint64_t code = std::lower_bound(table, table + kNumCodes, nibbles) - table;
+        return code | (lows << 12);
+    }
+
+    // The low kBucketBits of bits, as 4 tags packed like a Segment bucket.
+    // Hot loops pass DecodeTable() in to skip the static's guard.
+    static uint64_t Decode(uint64_t bits, const uint16_t *table = DecodeTable())
+    {
+        const uint64_t nibbles = table[bits & 0xFFF];
+        return _pdep_u64(bits >> 12, 0x0FF0FF0FF0FFULL) | _pdep_u64(nibbles, 0xF00F00F00F00ULL);
+    }
+
+    // nibble i of entry c is the top nibble of sorted tag i; the kNumCodes
+    // codes ascend, so Encode finds one by binary search
+    static const uint16_t *DecodeTable()
+    {
+        static const Table table;
+        return table.codes;
+    }
+
+private:
+    struct Table
+    {
+        uint16_t codes[kTableSize];
+
+        Table()
+        {
+            memset(codes, 0, sizeof(codes));
+            uint32_t n = 0;
+            for (uint32_t v = 0; v < 0x10000; v++)
+            {
+                if ((v & 0xF) <= (v >> 4 & 0xF) && (v >> 4 & 0xF) <= (v >> 8 & 0xF) && (v >> 8 & 0xF) <= (v >> 12))
+                {
+                    codes[n++] = v;
+                }
+            }
+        }
+    };
+
+    static bool HighNibbleLess(uint16_t a, uint16_t b)
+    {
+        return (a >> 8) < (b >> 8);
+    }
+};
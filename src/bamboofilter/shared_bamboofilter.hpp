@@ -0,0 +1,531 @@
+// Bamboo filter in a named POSIX shared-memory region: one writer process owns
+// the filter, any number of reader processes map the region read-only and look
+// keys up in place.
+//
+// Region layout: SharedFilterHeader | SharedSegmentEntry[max_segments] | arena.
+// All chain data lives in the arena; the header and the segment directory hold
+// everything a reader needs to locate a chain. The writer brackets every
+// mutation with a seqlock (odd seq = write in progress); a reader that sees seq
+// odd or changed across its probe retries, which covers in-place cuckoo kicks as
+// well as chain growth, Extend and Compress moving segments around the arena.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+
+static const uint64_t kSharedFilterMagic = 0x4242465348415245ULL; // "BBFSHARE"
+static const uint32_t kSharedFreeListSlots = 64;
+static const uint32_t kSharedBlockAlign = 64;
+
+// Both sides map the same bytes, so these atomics must be address-free.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared filter needs lock-free 32/64-bit atomics");
+
+struct SharedSegmentEntry
+{
+    std::atomic<uint64_t> offset; // from the start of the region
+    std::atomic<uint32_t> size;
+    std::atomic<uint32_t> chain_capacity;
+    std::atomic<uint32_t> chain_stride;
+};
+
+struct SharedFilterHeader
+{
+    uint64_t magic;
+    uint64_t region_size;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    uint64_t max_segments;
+    uint32_t init_table_bits;
+
+    std::atomic<uint64_t> seq;
+    std::atomic<uint32_t> num_table_bits;
+    std::atomic<uint64_t> num_segments;
+
+    // Writer-only allocator state: bump pointer and free lists keyed by block size.
+    uint64_t arena_used;
+    uint64_t free_size[kSharedFreeListSlots];
+    uint64_t free_head[kSharedFreeListSlots];
+};
+
+// SegmentArena over the arena part of the region. Freed blocks are reused for
+// later blocks of the same size; the seqlock keeps readers from trusting data
+// they read from a block that was recycled under them.
+class SharedArena : public SegmentArena
+{
+public:
+    bool dirty;
+    // once detached, freed blocks are left untouched so readers keep a valid table
+    bool detached;
+
+    SharedArena(char *region, SharedFilterHeader *header)
+        : dirty(false), detached(false), region_(region), header_(header)
+    {
+    }
+
+    char *Alloc(uint32_t size)
+    {
+        uint64_t block = RoundUp(size);
+        dirty = true;
+        for (uint32_t i = 0; i < kSharedFreeListSlots; i++)
+        {
+            if (header_->free_size[i] == block && header_->free_head[i])
+            {
+                char *p = region_ + header_->free_head[i];
+                header_->free_head[i] = *(uint64_t *)p;
+                return p;
+            }
+        }
+        if (header_->arena_used + block > header_->arena_size)
+        {
+            throw std::bad_alloc();
+        }
+        char *p = region_ + header_->arena_offset + header_->arena_used;
+        header_->arena_used += block;
+        return p;
+    }
+
+    void Free(char *p, uint32_t size)
+    {
+        if (detached)
+        {
+            return;
+        }
+        uint64_t block = RoundUp(size);
+        dirty = true;
+        for (uint32_t i = 0; i < kSharedFreeListSlots; i++)
+        {
+            if (header_->free_size[i] == block || header_->free_size[i] == 0)
+            {
+                header_->free_size[i] = block;
+                *(uint64_t *)p = header_->free_head[i];
+                header_->free_head[i] = p - region_;
+                return;
+            }
+        }
+        // more distinct block sizes than slots: the block is leaked
+    }
+
+private:
+    char *region_;
+    SharedFilterHeader *header_;
+
+    static uint64_t RoundUp(uint32_t size)
+    {
+        return (size + kSharedBlockAlign - 1) / kSharedBlockAlign * kSharedBlockAlign;
+    }
+};
+
+// Writer side. Creates the region, or starts a new filter in one a previous
+// writer left behind, and owns the only mutable handle to it; the region
+// outlives the writer until Unlink() is called.
+class SharedBambooFilter
+{
+public:
+    // An existing region keeps its size, which readers may have mapped: it is
+    // never truncated, and one smaller than region_size is an error.
+    SharedBambooFilter(const char *name, uint64_t region_size, uint64_t capacity,
+                       uint32_t split_condition_param, bool cache_aligned = false);
+    ~SharedBambooFilter();
+
+    // owns the mapping
+    SharedBambooFilter(const SharedBambooFilter &) = delete;
+    SharedBambooFilter &operator=(const SharedBambooFilter &) = delete;
+
+    bool Insert(const char *key);
+    bool Lookup(const char *key) const;
+    bool Delete(const char *key);
+
+    uint64_t ArenaUsed() const
+    {
+        return header_->arena_used;
+    }
+
+    static void Unlink(const char *name)
+    {
+        shm_unlink(name);
+    }
+
+private:
+    uint64_t region_size_;
+    char *region_;
+    SharedFilterHeader *header_;
+    SharedSegmentEntry *dir_;
+    SharedArena *arena_;
+    BambooFilter *filter_;
+
+    // What the write in progress can move: the segment of its key, and the
+    // segments an Extend or Compress it triggers splits or merges.
+    uint64_t write_seg_;
+    uint64_t write_num_segments_;
+    uint64_t write_split_idx_;
+
+    void BeginWrite(uint64_t hash)
+    {
+        uint32_t bucket_index, tag;
+        BambooFilter::IndexTagFromHash(hash, filter_->INIT_TABLE_BITS, filter_->num_table_bits_,
+                                       filter_->hash_table_.size(), write_seg_, bucket_index, tag);
+        write_num_segments_ = filter_->hash_table_.size();
+        write_split_idx_ = filter_->next_split_idx_;
+
+        header_->seq.store(header_->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // Also on the exception path: a Segment only takes a new block once it is
+    // fully built, so what is published is always a completed layout.
+    void EndWrite()
+    {
+        if (arena_->dirty)
+        {
+            PublishWrite();
+            arena_->dirty = false;
+        }
+        header_->seq.store(header_->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void PublishSegment(uint64_t i)
+    {
+        const Segment *seg = filter_->hash_table_[i];
+        dir_[i].offset.store(seg->Data() - region_, std::memory_order_relaxed);
+        dir_[i].size.store(seg->DataBytes(), std::memory_order_relaxed);
+        dir_[i].chain_capacity.store(seg->ChainCapacity(), std::memory_order_relaxed);
+        dir_[i].chain_stride.store(seg->Stride(), std::memory_order_relaxed);
+    }
+
+    void PublishGeometry()
+    {
+        header_->num_table_bits.store(filter_->num_table_bits_, std::memory_order_relaxed);
+        header_->num_segments.store(filter_->hash_table_.size(), std::memory_order_relaxed);
+    }
+
+    // Rewrites the whole directory and the geometry.
+    void Publish()
+    {
+        for (uint64_t i = 0; i < filter_->hash_table_.size(); i++)
+        {
+            PublishSegment(i);
+        }
+        PublishGeometry();
+    }
+
+    // Rewrites only the entries the write can have moved: its key's segment,
+    // plus, after an Extend, the split segment and the new one, or after a
+    // Compress, the segment that absorbed the last one.
+    void PublishWrite()
+    {
+        const uint64_t num_segments = filter_->hash_table_.size();
+        if (write_seg_ < num_segments)
+        {
+            PublishSegment(write_seg_);
+        }
+        if (num_segments == write_num_segments_)
+        {
+            return;
+        }
+        if (num_segments == write_num_segments_ + 1)
+        {
+            PublishSegment(write_split_idx_);
+            PublishSegment(num_segments - 1);
+        }
+        else if (num_segments + 1 == write_num_segments_)
+        {
+            PublishSegment(filter_->next_split_idx_);
+        }
+        else
+        {
+            Publish();
+            return;
+        }
+        PublishGeometry();
+    }
+};
+
+SharedBambooFilter::SharedBambooFilter(const char *name, uint64_t region_size, uint64_t capacity,
+                                       uint32_t split_condition_param, bool cache_aligned)
+    : region_size_(region_size)
+{
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("shm_open: ") + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error(std::string("fstat: ") + strerror(err));
+    }
+    // Readers of a previous writer may still map the region: truncating it
+    // would fault their loads, and growing it would move the arena they index.
+    if (st.st_size == 0 && ftruncate(fd, region_size) != 0)
+    {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error(std::string("ftruncate: ") + strerror(err));
+    }
+    if (st.st_size != 0 && (uint64_t)st.st_size < region_size)
+    {
+        close(fd);
+        throw std::runtime_error(std::string("shared filter region ") + name + " exists with a smaller size");
+    }
+    if (st.st_size != 0)
+    {
+        region_size = region_size_ = st.st_size;
+    }
+    void *p = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw std::runtime_error(std::string("mmap: ") + strerror(errno));
+    }
+    region_ = (char *)p;
+
+    // Every segment owns at least one block of its initial size, so a directory
+    // with one entry per minimal block can never overflow before the arena does.
+    const uint64_t min_block = (1ULL << BUCKETS_PER_SEG) * Segment::BucketBytes();
+    const uint64_t max_segments = region_size / min_block;
+    const uint64_t dir_offset = (sizeof(SharedFilterHeader) + kSharedBlockAlign - 1) / kSharedBlockAlign * kSharedBlockAlign;
+    const uint64_t arena_offset = (dir_offset + max_segments * sizeof(SharedSegmentEntry) + kSharedBlockAlign - 1) / kSharedBlockAlign * kSharedBlockAlign;
+    if (arena_offset + kSharedBlockAlign >= region_size)
+    {
+        munmap(region_, region_size);
+        throw std::runtime_error("shared filter region too small");
+    }
+
+    // A new region is zero-filled. In a reused one, readers may be probing the
+    // previous filter: seq goes odd before anything is rewritten and keeps
+    // counting up from the old value, so no probe can see it unchanged.
+    header_ = (SharedFilterHeader *)region_;
+    const uint64_t seq = header_->seq.load(std::memory_order_relaxed);
+    const uint64_t init_seq = seq + 1 + (seq & 1);
+    header_->seq.store(init_seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = 0;
+    header_->region_size = region_size;
+    header_->arena_offset = arena_offset;
+    // keep one block of slack so 8-byte bucket loads past a block stay mapped
+    header_->arena_size = region_size - arena_offset - kSharedBlockAlign;
+    header_->max_segments = max_segments;
+    header_->arena_used = 0;
+    header_->num_segments.store(0, std::memory_order_relaxed);
+    memset(header_->free_size, 0, sizeof(header_->free_size));
+    memset(header_->free_head, 0, sizeof(header_->free_head));
+    // entries past num_segments are never read
+    dir_ = (SharedSegmentEntry *)(region_ + dir_offset);
+
+    arena_ = new SharedArena(region_, header_);
+    filter_ = new BambooFilter(capacity, split_condition_param, cache_aligned, arena_);
+    header_->init_table_bits = filter_->INIT_TABLE_BITS;
+    Publish();
+    arena_->dirty = false;
+    header_->magic = kSharedFilterMagic;
+    header_->seq.store(init_seq + 1, std::memory_order_release);
+}
+
+SharedBambooFilter::~SharedBambooFilter()
+{
+    // the published table stays readable until the region is unlinked
+    arena_->detached = true;
+    delete filter_;
+    delete arena_;
+    munmap(region_, region_size_);
+}
+
+bool SharedBambooFilter::Insert(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    BeginWrite(hash);
+    try
+    {
+        bool ret = filter_->InsertHash(hash);
+        EndWrite();
+        return ret;
+    }
+    catch (...)
+    {
+        EndWrite();
+        throw;
+    }
+}
+
+bool SharedBambooFilter::Lookup(const char *key) const
+{
+    return filter_->Lookup(key);
+}
+
+bool SharedBambooFilter::Delete(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    BeginWrite(hash);
+    try
+    {
+        bool ret = filter_->DeleteHash(hash);
+        EndWrite();
+        return ret;
+    }
+    catch (...)
+    {
+        EndWrite();
+        throw;
+    }
+}
+
+// Reader side: maps an existing region read-only. Lookups copy nothing out of
+// the region except, for chains longer than the short-chain kernels, into a
+// per-thread scratch buffer.
+class SharedBambooFilterReader
+{
+public:
+    explicit SharedBambooFilterReader(const char *name);
+    ~SharedBambooFilterReader();
+
+    // owns the mapping
+    SharedBambooFilterReader(const SharedBambooFilterReader &) = delete;
+    SharedBambooFilterReader &operator=(const SharedBambooFilterReader &) = delete;
+
+    bool Lookup(const char *key) const;
+
+    // Number of completed writes seen so far; stable while nothing is written.
+    uint64_t Generation() const
+    {
+        return header_->seq.load(std::memory_order_acquire) >> 1;
+    }
+
+    // Probes that had to be repeated because a write overlapped them.
+    uint64_t Retries() const
+    {
+        return retries_.load(std::memory_order_relaxed);
+    }
+
+private:
+    uint64_t region_size_;
+    const char *region_;
+    const SharedFilterHeader *header_;
+    const SharedSegmentEntry *dir_;
+    mutable std::atomic<uint64_t> retries_;
+};
+
+SharedBambooFilterReader::SharedBambooFilterReader(const char *name)
+    : retries_(0)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("shm_open: ") + strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SharedFilterHeader))
+    {
+        close(fd);
+        throw std::runtime_error("shared filter region missing or truncated");
+    }
+    region_size_ = st.st_size;
+    void *p = mmap(NULL, region_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw std::runtime_error(std::string("mmap: ") + strerror(errno));
+    }
+    region_ = (const char *)p;
+    header_ = (const SharedFilterHeader *)region_;
+
+    // a writer may still be initializing the region, or restarting in it
+    bool ok;
+    for (;;)
+    {
+        const uint64_t seq = header_->seq.load(std::memory_order_acquire);
+        if (seq < 2 || (seq & 1))
+        {
+            _mm_pause();
+            continue;
+        }
+        ok = header_->magic == kSharedFilterMagic && header_->region_size == region_size_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->seq.load(std::memory_order_relaxed) == seq)
+        {
+            break;
+        }
+    }
+    if (!ok)
+    {
+        munmap((void *)region_, region_size_);
+        throw std::runtime_error("not a shared bamboo filter region");
+    }
+    const uint64_t dir_offset = (sizeof(SharedFilterHeader) + kSharedBlockAlign - 1) / kSharedBlockAlign * kSharedBlockAlign;
+    dir_ = (const SharedSegmentEntry *)(region_ + dir_offset);
+}
+
+SharedBambooFilterReader::~SharedBambooFilterReader()
+{
+    munmap((void *)region_, region_size_);
+}
+
+bool SharedBambooFilterReader::Lookup(const char *key) const
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+
+    for (;;)
+    {
+        const uint64_t seq = header_->seq.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+            retries_.fetch_add(1, std::memory_order_relaxed);
+            _mm_pause();
+            continue;
+        }
+
+        bool found = false;
+        bool valid = false;
+        const uint32_t num_table_bits = header_->num_table_bits.load(std::memory_order_relaxed);
+        const uint64_t num_segments = header_->num_segments.load(std::memory_order_relaxed);
+        if (num_segments && num_segments <= header_->max_segments && num_table_bits >= header_->init_table_bits)
+        {
+            uint64_t seg_index;
+            uint32_t bucket_index, tag;
+            BambooFilter::IndexTagFromHash(hash, header_->init_table_bits, num_table_bits, num_segments,
+                                           seg_index, bucket_index, tag);
+
+            const SharedSegmentEntry &e = dir_[seg_index < num_segments ? seg_index : 0];
+            const uint64_t offset = e.offset.load(std::memory_order_relaxed);
+            const uint32_t size = e.size.load(std::memory_order_relaxed);
+            const uint32_t capacity = e.chain_capacity.load(std::memory_order_relaxed);
+            const uint32_t stride = e.chain_stride.load(std::memory_order_relaxed);
+
+            // a torn read may pair fields of different versions: only probe what
+            // provably stays inside the arena
+            valid = seg_index < num_segments && capacity &&
+                    stride >= capacity * Segment::BucketBytes() &&
+                    (uint64_t)stride << BUCKETS_PER_SEG <= size &&
+                    offset >= header_->arena_offset &&
+                    offset + size <= header_->arena_offset + header_->arena_size;
+            if (valid)
+            {
+                found = Segment::LookupChains(region_ + offset, capacity, stride, bucket_index, tag);
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->seq.load(std::memory_order_relaxed) == seq)
+        {
+            return valid && found;
+        }
+        retries_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bitsutil.h"
+#include "bamboofilter/predefine.h"
+
+// Segment with 8-bit tags, 4 to a 32-bit bucket: the format a BambooFilter
+// switches to once it exceeds its memory budget (see
+// BambooFilter::SetMemoryBudget). Chains are organized as in Segment, and a
+// tag's alternate chain is its chain XOR a function of the tag, so tags can be
+// kicked. The caller picks the first chain (see BambooFilter::ShortTagHome).
+// When kicks fail, every chain grows by one bucket.
+class ShortTagSegment
+{
+public:
+    static const uint32_t kTagsPerBucket = 4;
+    static const uint32_t kTagBits = 8;
+
+    ShortTagSegment(uint32_t chain_num, uint32_t chain_capacity)
+        : chain_num(chain_num), chain_capacity(chain_capacity)
+    {
+        data = new uint32_t[chain_num * chain_capacity];
+        memset(data, 0, chain_num * chain_capacity * sizeof(uint32_t));
+    }
+
+    ShortTagSegment(const ShortTagSegment &s)
+        : chain_num(s.chain_num), chain_capacity(s.chain_capacity)
+    {
+        data = new uint32_t[chain_num * chain_capacity];
+        memcpy(data, s.data, chain_num * chain_capacity * sizeof(uint32_t));
+    }
+
+    ~ShortTagSegment()
+    {
+        delete[] data;
+    }
+
+    static uint32_t AltIndex(uint32_t chain_idx, uint8_t tag)
+    {
+        return (chain_idx ^ (((tag * 0x9E3779B1U) >> 22) | 1)) & ((1U << BUCKETS_PER_SEG) - 1);
+    }
+
+    // Adds tag to chain chain_idx, growing the segment if that chain is full.
+    void Put(uint32_t chain_idx, uint8_t tag)
+    {
+        if (!TryPut(chain_idx, tag))
+        {
+            Resize(chain_capacity + 1);
+            TryPut(chain_idx, tag);
+        }
+    }
+
+    void Insert(uint32_t chain_idx, uint8_t tag)
+    {
+        for (uint32_t count = 0; count < MAX_CUCKOO_KICK; count++)
+        {
+            if (TryPut(chain_idx, tag) || TryPut(AltIndex(chain_idx, tag), tag))
+            {
+                return;
+            }
+            uint32_t *bucket = data + chain_idx * chain_capacity + rand() % chain_capacity;
+            uint32_t shift = rand() % kTagsPerBucket * kTagBits;
+            uint8_t old_tag = *bucket >> shift;
+            *bucket = (*bucket & ~(0xFFU << shift)) | ((uint32_t)tag << shift);
+            tag = old_tag;
+            chain_idx = AltIndex(chain_idx, tag);
+        }
+        Put(chain_idx, tag);
+    }
+
+    // Stores tag in a free slot of either chain, without kicks or growth.
+    bool TryInsert(uint32_t chain_idx, uint32_t alt_idx, uint8_t tag)
+    {
+        return TryPut(chain_idx, tag) || TryPut(alt_idx, tag);
+    }
+
+    bool Lookup(uint32_t chain_idx, uint32_t alt_idx, uint8_t tag) const
+    {
+        const uint32_t *p1 = data + chain_idx * chain_capacity;
+        const uint32_t *p2 = data + alt_idx * chain_capacity;
+        bool found = false;
+        for (uint32_t i = 0; i < chain_capacity; i++)
+        {
+            found |= (hasvalue8(p1[i], tag) | hasvalue8(p2[i], tag)) != 0;
+        }
+        return found;
+    }
+
+    bool Delete(uint32_t chain_idx, uint32_t alt_idx, uint8_t tag)
+    {
+        return TryRemove(chain_idx, tag) || TryRemove(alt_idx, tag);
+    }
+
+    // As Segment::EraseEle: the source half keeps the tags whose actv_bit is 0,
+    // the new half those whose actv_bit is 1.
+    void EraseEle(bool is_src, uint32_t actv_bit)
+    {
+        for (uint32_t i = 0; i < chain_num * chain_capacity; i++)
+        {
+            uint32_t v = data[i];
+            for (uint32_t t = 0; t < kTagsPerBucket; t++)
+            {
+                uint32_t tag = (v >> (t * kTagBits)) & 0xFF;
+                if (tag && ((tag >> actv_bit) & 1) == is_src)
+                {
+                    v &= ~(0xFFU << (t * kTagBits));
+                }
+            }
+            data[i] = v;
+        }
+    }
+
+    void Absorb(const ShortTagSegment *segment)
+    {
+        // allocates before changing a member, as every resize here does
+        uint32_t *new_data = new uint32_t[chain_num * (chain_capacity + segment->chain_capacity)];
+        uint32_t *old_data = data;
+        uint32_t old_capacity = chain_capacity;
+        chain_capacity += segment->chain_capacity;
+        data = new_data;
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            memcpy(data + i * chain_capacity, old_data + i * old_capacity, old_capacity * sizeof(uint32_t));
+            memcpy(data + i * chain_capacity + old_capacity, segment->data + i * segment->chain_capacity,
+                   segment->chain_capacity * sizeof(uint32_t));
+        }
+        delete[] old_data;
+    }
+
+    // As Segment::Compact: packs every chain and shrinks to the fullest one.
+    void Compact()
+    {
+        uint32_t max_tags = 0;
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            uint32_t num_tags = 0;
+            for (uint32_t b = 0; b < chain_capacity; b++)
+            {
+                num_tags += NumTagsIn(data[i * chain_capacity + b]);
+            }
+            max_tags = max_tags > num_tags ? max_tags : num_tags;
+        }
+        uint32_t new_capacity = (max_tags + kTagsPerBucket - 1) / kTagsPerBucket;
+        new_capacity = new_capacity ? new_capacity : 1;
+        if (new_capacity >= chain_capacity)
+        {
+            return;
+        }
+
+        uint32_t *new_data = new uint32_t[chain_num * new_capacity];
+        uint32_t *old_data = data;
+        uint32_t old_capacity = chain_capacity;
+        chain_capacity = new_capacity;
+        data = new_data;
+        memset(data, 0, chain_num * chain_capacity * sizeof(uint32_t));
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            uint32_t cur = 0;
+            for (uint32_t b = 0; b < old_capacity; b++)
+            {
+                for (uint32_t t = 0; t < kTagsPerBucket; t++)
+                {
+                    uint32_t tag = (old_data[i * old_capacity + b] >> (t * kTagBits)) & 0xFF;
+                    if (tag)
+                    {
+                        data[i * chain_capacity + cur / kTagsPerBucket] |= tag << (cur % kTagsPerBucket * kTagBits);
+                        cur++;
+                    }
+                }
+            }
+        }
+        delete[] old_data;
+    }
+
+    uint32_t ChainCapacity() const
+    {
+        return chain_capacity;
+    }
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(ShortTagSegment) + chain_num * chain_capacity * sizeof(uint32_t);
+    }
+
+private:
+    const uint32_t chain_num;
+    uint32_t chain_capacity;
+    // chain i is data[i * chain_capacity, (i + 1) * chain_capacity)
+    uint32_t *data;
+
+    static uint32_t NumTagsIn(uint32_t v)
+    {
+        return ((v & 0xFF) != 0) + ((v & 0xFF00) != 0) + ((v & 0xFF0000) != 0) + ((v & 0xFF000000) != 0);
+    }
+
+    bool TryPut(uint32_t chain_idx, uint8_t tag)
+    {
+        uint32_t *p = data + chain_idx * chain_capacity;
+        for (uint32_t i = 0; i < chain_capacity; i++)
+        {
+            for (uint32_t t = 0; t < kTagsPerBucket; t++)
+            {
+                if (!((p[i] >> (t * kTagBits)) & 0xFF))
+                {
+                    p[i] |= (uint32_t)tag << (t * kTagBits);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool TryRemove(uint32_t chain_idx, uint8_t tag)
+    {
+        uint32_t *p = data + chain_idx * chain_capacity;
+        for (uint32_t i = 0; i < chain_capacity; i++)
+        {
+            for (uint32_t t = 0; t < kTagsPerBucket; t++)
+            {
+                if (((p[i] >> (t * kTagBits)) & 0xFF) == tag)
+                {
+                    p[i] &= ~(0xFFU << (t * kTagBits));
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void Resize(uint32_t capacity)
+    {
+        uint32_t *new_data = new uint32_t[chain_num * capacity];
+        uint32_t *old_data = data;
+        uint32_t old_capacity = chain_capacity;
+        chain_capacity = capacity;
+        data = new_data;
+        memset(data, 0, chain_num * chain_capacity * sizeof(uint32_t));
+        for (uint32_t i = 0; i < chain_num; i++)
+        {
+            memcpy(data + i * chain_capacity, old_data + i * old_capacity, old_capacity * sizeof(uint32_t));
+        }
+        delete[] old_data;
+    }
+};
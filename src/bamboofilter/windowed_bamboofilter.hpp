@@ -0,0 +1,165 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "common/timer.hpp"
+
+using std::vector;
+
+// "Seen in the last N generations" filter for stream deduplication: a ring of
+// num_generations BambooFilters. Inserts go to the newest generation, lookups
+// hash the key once and probe every live generation, and Advance() retires
+// the oldest generation as a whole, without touching its keys.
+//
+// Advance() is called explicitly, or by StartExpiry(), which runs it on the
+// thread of a common/timer.hpp Timer. A lookup matches any key inserted
+// within the last num_generations - 1 advances, plus FPR of roughly
+// num_generations times that of a single filter.
+//
+// Threading: every method may be called from any thread. The ring is guarded
+// by a reader-writer lock; Lookup takes it shared, so lookups run
+// concurrently, while Insert, Delete and Advance take it exclusively. Advance
+// builds the new generation before taking the lock and frees the retired one
+// after releasing it, so a rotation blocks the other threads only for a
+// pointer swap, and no caller ever pays for one it did not make.
+class WindowedBambooFilter
+{
+public:
+    WindowedBambooFilter(uint32_t num_generations, uint64_t capacity, uint32_t split_condition_param);
+    ~WindowedBambooFilter();
+
+    bool Insert(const char *key);
+    bool Lookup(const char *key) const;
+    // Removes key from the newest generation that holds it.
+    bool Delete(const char *key);
+
+    void Advance();
+
+    // Advances every interval_ms on a timer thread.
+    void StartExpiry(int interval_ms);
+    void StopExpiry();
+
+    // Number of advances made so far.
+    uint64_t Generation() const;
+
+    uint64_t SizeInBytes() const;
+
+private:
+    const uint64_t capacity_;
+    const uint32_t split_condition_param_;
+
+    // ring_[head_] is the newest generation; all entries are live
+    vector<BambooFilter *> ring_;
+    uint32_t head_;
+    uint64_t generation_;
+    mutable pthread_rwlock_t lock_;
+
+    // declared last: destroyed (and its thread stopped) before the ring
+    Timer expiry_timer_;
+};
+
+WindowedBambooFilter::WindowedBambooFilter(uint32_t num_generations, uint64_t capacity, uint32_t split_condition_param)
+    : capacity_(capacity),
+      split_condition_param_(split_condition_param),
+      head_(0),
+      generation_(0)
+{
+    pthread_rwlock_init(&lock_, NULL);
+    for (uint32_t i = 0; i < num_generations; i++)
+    {
+        ring_.push_back(new BambooFilter(capacity_, split_condition_param_));
+    }
+}
+
+WindowedBambooFilter::~WindowedBambooFilter()
+{
+    StopExpiry();
+    for (size_t i = 0; i < ring_.size(); i++)
+    {
+        delete ring_[i];
+    }
+    pthread_rwlock_destroy(&lock_);
+}
+
+bool WindowedBambooFilter::Insert(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    pthread_rwlock_wrlock(&lock_);
+    const bool inserted = ring_[head_]->InsertHash(hash);
+    pthread_rwlock_unlock(&lock_);
+    return inserted;
+}
+
+bool WindowedBambooFilter::Lookup(const char *key) const
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    bool found = false;
+    pthread_rwlock_rdlock(&lock_);
+    for (size_t i = 0; i < ring_.size() && !found; i++)
+    {
+        found = ring_[(head_ + ring_.size() - i) % ring_.size()]->LookupHash(hash);
+    }
+    pthread_rwlock_unlock(&lock_);
+    return found;
+}
+
+bool WindowedBambooFilter::Delete(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    bool deleted = false;
+    pthread_rwlock_wrlock(&lock_);
+    for (size_t i = 0; i < ring_.size() && !deleted; i++)
+    {
+        deleted = ring_[(head_ + ring_.size() - i) % ring_.size()]->DeleteHash(hash);
+    }
+    pthread_rwlock_unlock(&lock_);
+    return deleted;
+}
+
+void WindowedBambooFilter::Advance()
+{
+    BambooFilter *fresh = new BambooFilter(capacity_, split_condition_param_);
+    pthread_rwlock_wrlock(&lock_);
+    head_ = (head_ + 1) % ring_.size();
+    BambooFilter *retired = ring_[head_];
+    ring_[head_] = fresh;
+    generation_++;
+    pthread_rwlock_unlock(&lock_);
+    delete retired;
+}
+
+void WindowedBambooFilter::StartExpiry(int interval_ms)
+{
+    expiry_timer_.StartTimer(interval_ms, [this]() {
+        Advance();
+    });
+}
+
+void WindowedBambooFilter::StopExpiry()
+{
+    expiry_timer_.Expire();
+}
+
+uint64_t WindowedBambooFilter::Generation() const
+{
+    pthread_rwlock_rdlock(&lock_);
+    const uint64_t generation = generation_;
+    pthread_rwlock_unlock(&lock_);
+    return generation;
+}
+
+uint64_t WindowedBambooFilter::SizeInBytes() const
+{
+    uint64_t size = sizeof(WindowedBambooFilter);
+    pthread_rwlock_rdlock(&lock_);
+    for (size_t i = 0; i < ring_.size(); i++)
+    {
+        size += ring_[i]->SizeInBytes();
+    }
+    pthread_rwlock_unlock(&lock_);
+    return size;
+}
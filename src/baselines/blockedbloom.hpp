@@ -0,0 +1,95 @@
+// Split-block Bloom filter (Putze et al.; the variant used by Impala/Kudu): each
+// key sets one bit in each of the eight 32-bit words of a single 256-bit block,
+// so a lookup touches one cache line and is a handful of AVX2 instructions.
+// Baseline for the benchmarks; shares BambooFilter's key hash. No deletions.
+
+#pragma once
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+#include "bamboofilter/bamboofilter.hpp"
+
+class BlockedBloomFilter
+{
+public:
+    static const bool kSupportsDelete = false;
+
+    explicit BlockedBloomFilter(uint64_t capacity, double bits_per_key = 12);
+    ~BlockedBloomFilter();
+
+    bool Insert(const char *key)
+    {
+        return InsertHash(BambooFilter::HashKey(key));
+    }
+    bool Lookup(const char *key) const
+    {
+        return LookupHash(BambooFilter::HashKey(key));
+    }
+    bool Delete(const char * /* key */)
+    {
+        return false;
+    }
+
+    bool InsertHash(uint64_t hash);
+    bool LookupHash(uint64_t hash) const;
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(BlockedBloomFilter) + num_blocks_ * sizeof(__m256i);
+    }
+
+private:
+    uint64_t num_blocks_;
+    __m256i *blocks_;
+
+    uint64_t BlockIndex(uint64_t hash) const
+    {
+        return ((hash >> 32) * num_blocks_) >> 32;
+    }
+
+    // One bit per 32-bit lane, chosen by the top 5 bits of hash * salt[lane].
+    static __m256i MakeMask(uint32_t hash)
+    {
+        const __m256i salt = _mm256_setr_epi32(0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                               0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U);
+        __m256i h = _mm256_mullo_epi32(_mm256_set1_epi32(hash), salt);
+        h = _mm256_srli_epi32(h, 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), h);
+    }
+};
+
+BlockedBloomFilter::BlockedBloomFilter(uint64_t capacity, double bits_per_key)
+{
+    num_blocks_ = (uint64_t)(capacity * bits_per_key / 256) + 1;
+    void *p;
+    if (posix_memalign(&p, sizeof(__m256i), num_blocks_ * sizeof(__m256i)))
+    {
+        throw std::bad_alloc();
+    }
+    blocks_ = (__m256i *)p;
+    memset(blocks_, 0, num_blocks_ * sizeof(__m256i));
+}
+
+BlockedBloomFilter::~BlockedBloomFilter()
+{
+    free(blocks_);
+}
+
+bool BlockedBloomFilter::InsertHash(uint64_t hash)
+{
+    __m256i *block = blocks_ + BlockIndex(hash);
+    _mm256_store_si256(block, _mm256_or_si256(_mm256_load_si256(block), MakeMask((uint32_t)hash)));
+    return true;
+}
+
+bool BlockedBloomFilter::LookupHash(uint64_t hash) const
+{
+    const __m256i *block = blocks_ + BlockIndex(hash);
+    // all mask bits set <=> (~block & mask) == 0
+    return _mm256_testc_si256(_mm256_load_si256(block), MakeMask((uint32_t)hash));
+}
@@ -0,0 +1,217 @@
+// Standard cuckoo filter (Fan et al., CoNEXT 2014): fixed table of 4-way buckets
+// with 12-bit tags packed into 6 bytes, the same bucket format as Segment.
+// Baseline for the benchmarks; shares BambooFilter's key hash.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+class CuckooFilter
+{
+public:
+    static const bool kSupportsDelete = true;
+
+    explicit CuckooFilter(uint64_t capacity);
+    ~CuckooFilter();
+
+    bool Insert(const char *key)
+    {
+        return InsertHash(BambooFilter::HashKey(key));
+    }
+    bool Lookup(const char *key) const
+    {
+        return LookupHash(BambooFilter::HashKey(key));
+    }
+    bool Delete(const char *key)
+    {
+        return DeleteHash(BambooFilter::HashKey(key));
+    }
+
+    // Once an insert has run out of kicks, the homeless tag is kept as the victim
+    // and the filter is full: further inserts fail.
+    bool InsertHash(uint64_t hash);
+    bool LookupHash(uint64_t hash) const;
+    bool DeleteHash(uint64_t hash);
+
+    bool Full() const
+    {
+        return victim_used_;
+    }
+
+    uint64_t SizeInBytes() const
+    {
+        return sizeof(CuckooFilter) + num_buckets_ * kBytesPerBucket + kSafePad;
+    }
+
+private:
+    static const uint32_t kTagsPerBucket = 4;
+    static const uint32_t kBytesPerBucket = 6;
+    static const uint32_t kSafePad = sizeof(uint64_t) - kBytesPerBucket;
+    static const uint32_t kTagMask = 0xFFF;
+    static const uint32_t kMaxKicks = 500;
+
+    uint64_t num_buckets_;
+    char *data_;
+
+    bool victim_used_;
+    uint64_t victim_index_;
+    uint32_t victim_tag_;
+
+    uint64_t IndexHash(uint64_t hash) const
+    {
+        return hash & (num_buckets_ - 1);
+    }
+
+    static uint32_t TagHash(uint64_t hash)
+    {
+        uint32_t tag = (hash >> 32) & kTagMask;
+        return tag ? tag : 1;
+    }
+
+    uint64_t AltIndex(uint64_t index, uint32_t tag) const
+    {
+        return IndexHash(index ^ (tag * 0x5bd1e995ULL));
+    }
+
+    char *Bucket(uint64_t index) const
+    {
+        return data_ + index * kBytesPerBucket;
+    }
+
+    static uint32_t ReadTag(const char *p, uint32_t idx)
+    {
+        p += idx + (idx >> 1);
+        return (*((uint16_t *)p) >> ((idx & 1) << 2)) & kTagMask;
+    }
+
+    static void WriteTag(char *p, uint32_t idx, uint32_t tag)
+    {
+        p += idx + (idx >> 1);
+        if ((idx & 1) == 0)
+        {
+            ((uint16_t *)p)[0] = (((uint16_t *)p)[0] & 0xf000) | tag;
+        }
+        else
+        {
+            ((uint16_t *)p)[0] = (((uint16_t *)p)[0] & 0x000f) | (tag << 4);
+        }
+    }
+
+    static bool BucketHas(const char *p, uint32_t tag)
+    {
+        uint64_t v = *((uint64_t *)p);
+        return hasvalue12(v, tag);
+    }
+
+    static bool TryPut(char *p, uint32_t tag)
+    {
+        for (uint32_t i = 0; i < kTagsPerBucket; i++)
+        {
+            if (!ReadTag(p, i))
+            {
+                WriteTag(p, i, tag);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool TryRemove(char *p, uint32_t tag)
+    {
+        for (uint32_t i = 0; i < kTagsPerBucket; i++)
+        {
+            if (ReadTag(p, i) == tag)
+            {
+                WriteTag(p, i, 0);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+CuckooFilter::CuckooFilter(uint64_t capacity)
+    : victim_used_(false), victim_index_(0), victim_tag_(0)
+{
+    // 95% is the usual maximal load of a (2,4) cuckoo table
+    num_buckets_ = upperpower2((uint64_t)(capacity / kTagsPerBucket / 0.95) + 1);
+    data_ = new char[num_buckets_ * kBytesPerBucket + kSafePad];
+    memset(data_, 0, num_buckets_ * kBytesPerBucket + kSafePad);
+}
+
+CuckooFilter::~CuckooFilter()
+{
+    delete[] data_;
+}
+
+bool CuckooFilter::InsertHash(uint64_t hash)
+{
+    if (victim_used_)
+    {
+        return false;
+    }
+    uint64_t index = IndexHash(hash);
+    uint32_t tag = TagHash(hash);
+    if (TryPut(Bucket(index), tag) || TryPut(Bucket(AltIndex(index, tag)), tag))
+    {
+        return true;
+    }
+
+    index = (rand() & 1) ? index : AltIndex(index, tag);
+    for (uint32_t kick = 0; kick < kMaxKicks; kick++)
+    {
+        uint32_t slot = rand() % kTagsPerBucket;
+        uint32_t old_tag = ReadTag(Bucket(index), slot);
+        WriteTag(Bucket(index), slot, tag);
+        tag = old_tag;
+        index = AltIndex(index, tag);
+        if (TryPut(Bucket(index), tag))
+        {
+            return true;
+        }
+    }
+    victim_used_ = true;
+    victim_index_ = index;
+    victim_tag_ = tag;
+    return true;
+}
+
+bool CuckooFilter::LookupHash(uint64_t hash) const
+{
+    uint64_t index = IndexHash(hash);
+    uint32_t tag = TagHash(hash);
+    uint64_t index2 = AltIndex(index, tag);
+    if (victim_used_ && victim_tag_ == tag && (victim_index_ == index || victim_index_ == index2))
+    {
+        return true;
+    }
+    return BucketHas(Bucket(index), tag) || BucketHas(Bucket(index2), tag);
+}
+
+bool CuckooFilter::DeleteHash(uint64_t hash)
+{
+    uint64_t index = IndexHash(hash);
+    uint32_t tag = TagHash(hash);
+    uint64_t index2 = AltIndex(index, tag);
+    if (TryRemove(Bucket(index), tag) || TryRemove(Bucket(index2), tag))
+    {
+        // the victim may now fit into the table again
+        if (victim_used_)
+        {
+            victim_used_ = false;
+            InsertHash(((uint64_t)victim_tag_ << 32) | victim_index_);
+        }
+        return true;
+    }
+    if (victim_used_ && victim_tag_ == tag && (victim_index_ == index || victim_index_ == index2))
+    {
+        victim_used_ = false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,87 @@
+// Dynamic cuckoo filter (Chen et al., ICNP 2017): a growing list of same-size
+// cuckoo filters. Inserts go to the newest filter and a new one is appended
+// once it is full; lookups and deletes probe every filter in the list.
+// Baseline for the benchmarks; shares BambooFilter's key hash.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "baselines/cuckoofilter.hpp"
+#include "bamboofilter/bamboofilter.hpp"
+
+class DynamicCuckooFilter
+{
+public:
+    static const bool kSupportsDelete = true;
+
+    explicit DynamicCuckooFilter(uint64_t capacity)
+        : capacity_(capacity)
+    {
+        filters_.push_back(new CuckooFilter(capacity_));
+    }
+
+    ~DynamicCuckooFilter()
+    {
+        for (size_t i = 0; i < filters_.size(); i++)
+        {
+            delete filters_[i];
+        }
+    }
+
+    bool Insert(const char *key);
+    bool Lookup(const char *key) const;
+    bool Delete(const char *key);
+
+    uint64_t SizeInBytes() const
+    {
+        uint64_t size = sizeof(DynamicCuckooFilter) + filters_.capacity() * sizeof(CuckooFilter *);
+        for (size_t i = 0; i < filters_.size(); i++)
+        {
+            size += filters_[i]->SizeInBytes();
+        }
+        return size;
+    }
+
+private:
+    const uint64_t capacity_;
+    std::vector<CuckooFilter *> filters_;
+};
+
+bool DynamicCuckooFilter::Insert(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    if (filters_.back()->Full())
+    {
+        filters_.push_back(new CuckooFilter(capacity_));
+    }
+    return filters_.back()->InsertHash(hash);
+}
+
+bool DynamicCuckooFilter::Lookup(const char *key) const
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    for (size_t i = 0; i < filters_.size(); i++)
+    {
+        if (filters_[i]->LookupHash(hash))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DynamicCuckooFilter::Delete(const char *key)
+{
+    const uint64_t hash = BambooFilter::HashKey(key);
+    for (size_t i = filters_.size(); i-- > 0;)
+    {
+        if (filters_[i]->DeleteHash(hash))
+        {
+            return true;
+        }
+    }
+    return false;
+}
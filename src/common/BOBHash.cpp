@@ -47,7 +47,7 @@ uint32_t BOBHash::run(const void* buf, uint32_t len) {
     return BOBHash::run(buf, len, this->primeNum);
 }
 
-uint32_t BOBHash::run(const void* buf, uint32_t len, uint32_t primeNum) {
+static inline void runAll(const void* buf, uint32_t len, uint32_t primeNum, uint32_t& pa, uint32_t& pb, uint32_t& pc) {
     const char* str = (const char*)buf;
     //register ub4 a,b,c,len;
     uint32_t a, b, c;
@@ -101,7 +101,27 @@ uint32_t BOBHash::run(const void* buf, uint32_t len, uint32_t primeNum) {
     }
     mix(a, b, c);
     /*-------------------------------------------- report the result */
+    pa = a;
+    pb = b;
+    pc = c;
+}
+
+uint32_t BOBHash::run(const void* buf, uint32_t len, uint32_t primeNum) {
+    uint32_t a, b, c;
+    runAll(buf, len, primeNum, a, b, c);
     return c;
 }
 
+// lookup2's final mix only guarantees that every bit of c depends on every
+// input bit; b is left partly mixed (unlike b in lookup3's hashlittle2). So the
+// upper half comes from c after one more mix of the final state, and the lower
+// half is the same as run().
+uint64_t BOBHash::run64(const void* buf, uint32_t len, uint32_t primeNum) {
+    uint32_t a, b, c;
+    runAll(buf, len, primeNum, a, b, c);
+    const uint32_t lo = c;
+    mix(a, b, c);
+    return ((uint64_t)c << 32) | lo;
+}
+
 BOBHash::~BOBHash() {}
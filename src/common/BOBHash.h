@@ -12,6 +12,7 @@ public:
 
     uint32_t run(const void* buf, uint32_t len);
     static uint32_t run(const void* buf, uint32_t len, uint32_t primeNum);
+    static uint64_t run64(const void* buf, uint32_t len, uint32_t primeNum);
 
 private:
     uint32_t primeNum;
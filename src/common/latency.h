@@ -0,0 +1,265 @@
+// Per-operation latency histograms in TSC cycles, for use in benchmarking.
+//
+// Compiled in only when ENABLE_LATENCY_HISTOGRAM is defined; otherwise the
+// LATENCY_* macros expand to nothing, and bamboofilter.hpp does not include
+// this header at all.
+// Each thread records into its own histograms (no sharing on the hot path);
+// CollectLatency() merges the histograms of all live and exited threads.
+
+#pragma once
+
+#include <stdint.h>
+#include <x86intrin.h>
+
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+enum LatencyEvent
+{
+    kLatencyInsert,
+    kLatencyInsertGrow,
+    kLatencyInsertExtend,
+    kLatencyLookup,
+    kLatencyLookupLongChain,
+    kLatencyDelete,
+    kLatencyDeleteCompress,
+    kNumLatencyEvents
+};
+
+inline const char *LatencyEventName(int event)
+{
+    static const char *const names[kNumLatencyEvents] = {
+        "insert", "insert+grow", "insert+extend",
+        "lookup", "lookup(long chain)",
+        "delete", "delete+compress"};
+    return names[event];
+}
+
+// Log-bucketed histogram: values below 2^kSubBits are exact, every further
+// power of two is split into 2^kSubBits linear sub-buckets (<= 25% error).
+class LatencyHistogram
+{
+public:
+    static const int kSubBits = 2;
+    static const int kNumBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    LatencyHistogram()
+    {
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            counts_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static int BucketOf(uint64_t v)
+    {
+        if (v < (1ULL << kSubBits))
+        {
+            return (int)v;
+        }
+        int msb = 63 - __builtin_clzll(v);
+        int sub = (int)((v >> (msb - kSubBits)) & ((1ULL << kSubBits) - 1));
+        return ((msb - kSubBits + 1) << kSubBits) + sub;
+    }
+
+    // Smallest value that falls into bucket b.
+    static uint64_t BucketLow(int b)
+    {
+        if (b < (1 << kSubBits))
+        {
+            return b;
+        }
+        int msb = (b >> kSubBits) + kSubBits - 1;
+        uint64_t sub = b & ((1 << kSubBits) - 1);
+        return (1ULL << msb) | (sub << (msb - kSubBits));
+    }
+
+    // Only the owning thread writes, so a relaxed load/store pair is enough and
+    // keeps concurrent readers race-free without a locked add.
+    void Record(uint64_t v)
+    {
+        std::atomic<uint64_t> &c = counts_[BucketOf(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void Merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            counts_[i].store(Count(i) + other.Count(i), std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Count(int b) const
+    {
+        return counts_[b].load(std::memory_order_relaxed);
+    }
+
+    uint64_t Total() const
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            total += Count(i);
+        }
+        return total;
+    }
+
+    // Lower bound of the bucket holding the q-quantile (0 < q <= 1).
+    uint64_t Percentile(double q) const
+    {
+        uint64_t total = Total();
+        uint64_t rank = (uint64_t)(q * total);
+        uint64_t seen = 0;
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            seen += Count(i);
+            if (seen > rank || (seen == total && seen))
+            {
+                return BucketLow(i);
+            }
+        }
+        return 0;
+    }
+
+    uint64_t Max() const
+    {
+        for (int i = kNumBuckets - 1; i >= 0; i--)
+        {
+            if (Count(i))
+            {
+                return BucketLow(i);
+            }
+        }
+        return 0;
+    }
+
+private:
+    std::atomic<uint64_t> counts_[kNumBuckets];
+};
+
+class LatencyHistogramSet
+{
+public:
+    LatencyHistogram hist[kNumLatencyEvents];
+
+    void Merge(const LatencyHistogramSet &other)
+    {
+        for (int e = 0; e < kNumLatencyEvents; e++)
+        {
+            hist[e].Merge(other.hist[e]);
+        }
+    }
+
+    // One summary row per event in cycles; with buckets, also every non-empty
+    // bucket as "event <low> <count>" for plotting.
+    void Print(std::ostream &os, bool buckets = false) const
+    {
+        os << std::left << std::setw(20) << "event" << "\tcount\tp50\tp90\tp99\tp99.9\tmax" << std::endl;
+        for (int e = 0; e < kNumLatencyEvents; e++)
+        {
+            const LatencyHistogram &h = hist[e];
+            if (!h.Total())
+            {
+                continue;
+            }
+            os << std::left << std::setw(20) << LatencyEventName(e) << "\t" << h.Total() << "\t"
+               << h.Percentile(0.5) << "\t" << h.Percentile(0.9) << "\t"
+               << h.Percentile(0.99) << "\t" << h.Percentile(0.999) << "\t" << h.Max() << std::endl;
+        }
+        if (!buckets)
+        {
+            return;
+        }
+        for (int e = 0; e < kNumLatencyEvents; e++)
+        {
+            for (int b = 0; b < LatencyHistogram::kNumBuckets; b++)
+            {
+                if (hist[e].Count(b))
+                {
+                    os << LatencyEventName(e) << "\t" << LatencyHistogram::BucketLow(b) << "\t" << hist[e].Count(b) << std::endl;
+                }
+            }
+        }
+    }
+};
+
+class LatencyRecorder;
+
+struct LatencyRegistry
+{
+    std::mutex mutex;
+    std::vector<LatencyRecorder *> live;
+    LatencyHistogramSet retired;
+
+    static LatencyRegistry &Get()
+    {
+        static LatencyRegistry registry;
+        return registry;
+    }
+};
+
+// Thread-local histograms, registered on first use and folded into the
+// registry when the thread exits.
+class LatencyRecorder
+{
+public:
+    LatencyHistogramSet histograms;
+
+    static LatencyRecorder &Local()
+    {
+        static thread_local LatencyRecorder recorder;
+        return recorder;
+    }
+
+    void Record(LatencyEvent event, uint64_t cycles)
+    {
+        histograms.hist[event].Record(cycles);
+    }
+
+private:
+    LatencyRecorder()
+    {
+        LatencyRegistry &r = LatencyRegistry::Get();
+        std::lock_guard<std::mutex> locker(r.mutex);
+        r.live.push_back(this);
+    }
+
+    ~LatencyRecorder()
+    {
+        LatencyRegistry &r = LatencyRegistry::Get();
+        std::lock_guard<std::mutex> locker(r.mutex);
+        r.retired.Merge(histograms);
+        for (size_t i = 0; i < r.live.size(); i++)
+        {
+            if (r.live[i] == this)
+            {
+                r.live[i] = r.live.back();
+                r.live.pop_back();
+                break;
+            }
+        }
+    }
+};
+
+inline void CollectLatency(LatencyHistogramSet &out)
+{
+    LatencyRegistry &r = LatencyRegistry::Get();
+    std::lock_guard<std::mutex> locker(r.mutex);
+    out.Merge(r.retired);
+    for (size_t i = 0; i < r.live.size(); i++)
+    {
+        out.Merge(r.live[i]->histograms);
+    }
+}
+
+#ifdef ENABLE_LATENCY_HISTOGRAM
+#define LATENCY_START() const uint64_t latency_start_ = __rdtsc()
+#define LATENCY_RECORD(event) LatencyRecorder::Local().Record((event), __rdtsc() - latency_start_)
+#else
+#define LATENCY_START()
+#define LATENCY_RECORD(event)
+#endif
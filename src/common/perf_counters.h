@@ -0,0 +1,165 @@
+// Hardware performance counters around benchmark phases, via perf_event_open.
+//
+// Each event is opened on its own for this thread, user space only, so it
+// works with perf_event_paranoid <= 2 and one event the CPU or VM lacks does
+// not take the others down. Events the kernel multiplexes are scaled by
+// enabled / running time. If an event cannot be opened, its column prints
+// "-" and Error() says why; the benchmark itself runs unchanged.
+
+#pragma once
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ostream>
+#include <string>
+
+enum PerfCounter
+{
+    kPerfInstructions,
+    kPerfL1dMisses,
+    kPerfLlcMisses,
+    kPerfDtlbMisses,
+    kPerfBranchMisses,
+    kNumPerfCounters
+};
+
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+        static const uint32_t types[kNumPerfCounters] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        static const uint64_t configs[kNumPerfCounters] = {
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_BRANCH_MISSES};
+
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[c];
+            attr.config = configs[c];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[c] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds_[c] < 0 && error_.empty())
+            {
+                error_ = std::string(Name(c)) + ": " + strerror(errno);
+            }
+            values_[c] = 0;
+        }
+    }
+
+    ~PerfCounters()
+    {
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            if (fds_[c] >= 0)
+            {
+                close(fds_[c]);
+            }
+        }
+    }
+
+    static const char *Name(int counter)
+    {
+        static const char *const names[kNumPerfCounters] = {"instructions", "L1d-misses", "LLC-misses",
+                                                            "dTLB-misses", "branch-misses"};
+        return names[counter];
+    }
+
+    bool Available(int counter) const
+    {
+        return fds_[counter] >= 0;
+    }
+
+    // The first reason a counter could not be opened; empty if all opened.
+    const std::string &Error() const
+    {
+        return error_;
+    }
+
+    void Start()
+    {
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            if (fds_[c] >= 0)
+            {
+                ioctl(fds_[c], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds_[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    void Stop()
+    {
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            if (fds_[c] >= 0)
+            {
+                ioctl(fds_[c], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            // value, time enabled, time running
+            uint64_t buf[3];
+            values_[c] = 0;
+            if (fds_[c] >= 0 && read(fds_[c], buf, sizeof(buf)) == sizeof(buf) && buf[2])
+            {
+                values_[c] = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+            }
+        }
+    }
+
+    // Count between the last Start and Stop.
+    uint64_t Value(int counter) const
+    {
+        return values_[counter];
+    }
+
+    // Tab-separated column names, for a header line matching PrintPerOp.
+    static void PrintHeader(std::ostream &os)
+    {
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            os << (c ? "\t" : "") << Name(c) << "/op";
+        }
+    }
+
+    // Tab-separated counts per operation of the last phase; "-" where a
+    // counter is unavailable.
+    void PrintPerOp(std::ostream &os, uint64_t ops) const
+    {
+        for (int c = 0; c < kNumPerfCounters; c++)
+        {
+            os << (c ? "\t" : "");
+            if (Available(c) && ops)
+            {
+                os << (double)values_[c] / ops;
+            }
+            else
+            {
+                os << "-";
+            }
+        }
+    }
+
+private:
+    int fds_[kNumPerfCounters];
+    uint64_t values_[kNumPerfCounters];
+    std::string error_;
+};
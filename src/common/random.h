@@ -8,41 +8,34 @@
 #include <random>
 #include <stdexcept>
 #include <string>
-#include <unordered_set>
 #include <vector>
+
+#include "common/workload.h"
+
 using std::string;
-using std::unordered_set;
 using std::vector;
 
+// count distinct keys to insert and count others to look up, as decimal
+// strings. The keys come from GenerateKeys (workload.h) with a random seed,
+// so they are distinct by construction and generated in parallel.
 void GenerateRandom64(::std::size_t count, vector<string> &to_add, vector<string> &to_lookup)
 {
-    unordered_set<string> s;
     ::std::random_device random;
-    // To generate random keys to lookup, this uses ::std::random_device which is slower but
-    // stronger than some other pseudo-random alternatives. The reason is that some of these
-    // alternatives (like libstdc++'s ::std::default_random, which is a linear congruential
-    // generator) behave non-randomly under some hash families like Dietzfelbinger's
-    // multiply-shift.
-    auto genrand = [&random]() {
-        return random() + (static_cast<::std::uint64_t>(random()) << 32);
-    };
-    while (s.size() < 2 * count)
+    const ::std::uint64_t seed = random() + (static_cast<::std::uint64_t>(random()) << 32);
+    vector<::std::uint64_t> keys(2 * count);
+    if (count)
     {
-        s.insert(std::to_string(genrand()));
+        GenerateKeys(2 * count, 0, seed, &keys[0]);
     }
 
-    size_t i = 0;
-    for (auto ele : s)
+    const size_t first_add = to_add.size(), first_lookup = to_lookup.size();
+    to_add.resize(first_add + count);
+    to_lookup.resize(first_lookup + count);
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < (int64_t)count; i++)
     {
-        if (i < count)
-        {
-            to_add.push_back(ele);
-        }
-        else
-        {
-            to_lookup.push_back(ele);
-        }
-        i++;
+        to_add[first_add + i] = ::std::to_string(keys[i]);
+        to_lookup[first_lookup + i] = ::std::to_string(keys[count + i]);
     }
 }
 
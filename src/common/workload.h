@@ -0,0 +1,348 @@
+// Benchmark workloads: unique 64-bit keys, skewed operation traces, and a
+// compact binary trace file format.
+//
+// Key i of a workload is Mix64(seed + i). Mix64 is a bijection, so any range
+// of indices yields distinct keys without a set to deduplicate them, and every
+// key can be generated independently, in parallel, straight into a
+// preallocated buffer. Lookups of absent keys draw indices from the top half
+// of the index space, which inserts never reach.
+//
+// A trace is a load phase that inserts num_keys keys, then num_ops operations
+// drawn from a WorkloadSpec. Inserts add fresh keys and deletes remove the
+// oldest live key, so the live keys are always a window of indices
+// [oldest, newest). Lookups pick a rank in that window (0 = newest) from the
+// spec's distribution. Ops are generated in fixed-size chunks, each with its
+// own random stream, so a trace depends on the seed but not on the thread count.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum KeyDistribution
+{
+    kUniformKeys,
+    // Zipfian over ranks, P(rank r) ~ 1 / (r + 1)^zipf_theta
+    kZipfianKeys,
+    // hot_probability of the lookups go to the hot_fraction newest keys
+    kHotSetKeys,
+};
+
+enum TraceOp
+{
+    kTraceInsert = 0,
+    kTraceLookup = 1,
+    kTraceDelete = 2,
+};
+
+struct WorkloadSpec
+{
+    KeyDistribution distribution;
+    double zipf_theta;
+    double hot_fraction;
+    double hot_probability;
+    // Operation mix of the run phase; lookups take the rest.
+    double insert_ratio;
+    double delete_ratio;
+    // Share of lookups for keys that were never inserted.
+    double negative_ratio;
+    uint64_t seed;
+
+    WorkloadSpec()
+        : distribution(kUniformKeys), zipf_theta(0.99), hot_fraction(0.01), hot_probability(0.9),
+          insert_ratio(0), delete_ratio(0), negative_ratio(0.5), seed(1)
+    {
+    }
+};
+
+struct Trace
+{
+    // Column layout, as in the file: the key of op i and what to do with it.
+    std::vector<uint64_t> keys;
+    std::vector<uint8_t> ops;
+};
+
+// splitmix64's output function; a bijection on 64-bit values
+inline uint64_t Mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// splitmix64 stream, one per chunk of a trace
+class SplitMix64
+{
+public:
+    explicit SplitMix64(uint64_t seed) : state_(seed)
+    {
+    }
+
+    uint64_t Next()
+    {
+        state_ += 0x9E3779B97F4A7C15ULL;
+        return Mix64(state_);
+    }
+
+    // uniform in [0, 1)
+    double NextDouble()
+    {
+        return (Next() >> 11) * (1.0 / (1ULL << 53));
+    }
+
+    // uniform in [0, n)
+    uint64_t NextBelow(uint64_t n)
+    {
+        return (uint64_t)((unsigned __int128)Next() * n >> 64);
+    }
+
+private:
+    uint64_t state_;
+};
+
+// Zipfian ranks in [0, n) by the method of Gray et al., "Quickly Generating
+// Billion-Record Synthetic Databases" (SIGMOD 1994), as used by YCSB. The
+// normalization sums of every n up to the constructor's are kept (the terms
+// computed in parallel), so a trace can sample over a window that grows and
+// shrinks; sampling is O(1).
+class ZipfianGenerator
+{
+public:
+    ZipfianGenerator(uint64_t max_n, double theta) : theta_(theta), zeta_(max_n + 1)
+    {
+        if (!(theta > 0 && theta < 1))
+        {
+            throw std::invalid_argument("ZipfianGenerator: theta must be in (0, 1)");
+        }
+        zeta_[0] = 0;
+#pragma omp parallel for schedule(static)
+        for (int64_t i = 1; i <= (int64_t)max_n; i++)
+        {
+            zeta_[i] = 1.0 / pow((double)i, theta);
+        }
+        for (uint64_t i = 1; i <= max_n; i++)
+        {
+            zeta_[i] += zeta_[i - 1];
+        }
+        alpha_ = 1.0 / (1.0 - theta);
+        half_pow_theta_ = pow(0.5, theta);
+    }
+
+    // n in [1, max_n]
+    uint64_t Next(SplitMix64 &rng, uint64_t n) const
+    {
+        const double zetan = zeta_[n];
+        const double u = rng.NextDouble();
+        const double uz = u * zetan;
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+        if (uz < 1.0 + half_pow_theta_)
+        {
+            return 1;
+        }
+        // n >= 3 here: for n <= 2, uz < zetan covers both ranks above
+        const double eta = (1.0 - pow(2.0 / n, 1.0 - theta_)) / (1.0 - zeta_[2] / zetan);
+        const uint64_t rank = (uint64_t)(n * pow(eta * u - eta + 1.0, alpha_));
+        return rank < n ? rank : n - 1;
+    }
+
+private:
+    const double theta_;
+    // zeta_[n] = sum of 1 / i^theta for i in [1, n]
+    std::vector<double> zeta_;
+    double alpha_, half_pow_theta_;
+};
+
+// Keys first_index .. first_index + count - 1 of the workload seeded with seed.
+inline void GenerateKeys(uint64_t count, uint64_t first_index, uint64_t seed, uint64_t *out)
+{
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < (int64_t)count; i++)
+    {
+        out[i] = Mix64(seed + first_index + i);
+    }
+}
+
+void GenerateTrace(const WorkloadSpec &spec, uint64_t num_keys, uint64_t num_ops, Trace &trace)
+{
+    static const uint64_t kChunkOps = 1 << 16;
+    const uint64_t kNegativeBase = 1ULL << 63;
+
+    if (spec.insert_ratio + spec.delete_ratio > 1 || spec.insert_ratio < 0 || spec.delete_ratio < 0)
+    {
+        throw std::invalid_argument("GenerateTrace: bad operation mix");
+    }
+    trace.keys.resize(num_keys + num_ops);
+    trace.ops.resize(num_keys + num_ops);
+    if (num_keys)
+    {
+        GenerateKeys(num_keys, 0, spec.seed, &trace.keys[0]);
+        memset(&trace.ops[0], kTraceInsert, num_keys);
+    }
+
+    // pass 1: the op of every run-phase slot
+    const uint64_t num_chunks = (num_ops + kChunkOps - 1) / kChunkOps;
+    uint8_t *ops = num_ops ? &trace.ops[num_keys] : NULL;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t c = 0; c < (int64_t)num_chunks; c++)
+    {
+        SplitMix64 rng(Mix64(spec.seed ^ (2 * c + 1)));
+        const uint64_t end = std::min<uint64_t>((c + 1) * kChunkOps, num_ops);
+        for (uint64_t i = c * kChunkOps; i < end; i++)
+        {
+            const double u = rng.NextDouble();
+            ops[i] = u < spec.insert_ratio ? kTraceInsert
+                                           : u < spec.insert_ratio + spec.delete_ratio ? kTraceDelete : kTraceLookup;
+        }
+    }
+
+    // how many inserts and deletes precede each chunk. A delete-heavy mix can
+    // empty the window; a delete there becomes a lookup (a miss, in pass 2) and
+    // does not move oldest, so this pass runs in order over the op bytes.
+    std::vector<uint64_t> chunk_inserts(num_chunks + 1, 0), chunk_deletes(num_chunks + 1, 0);
+    uint64_t inserted = 0, deleted = 0;
+    for (uint64_t c = 0; c < num_chunks; c++)
+    {
+        const uint64_t end = std::min<uint64_t>((c + 1) * kChunkOps, num_ops);
+        for (uint64_t i = c * kChunkOps; i < end; i++)
+        {
+            if (ops[i] == kTraceInsert)
+            {
+                inserted++;
+            }
+            else if (ops[i] == kTraceDelete)
+            {
+                if (deleted < num_keys + inserted)
+                {
+                    deleted++;
+                }
+                else
+                {
+                    ops[i] = kTraceLookup;
+                }
+            }
+        }
+        chunk_inserts[c + 1] = inserted;
+        chunk_deletes[c + 1] = deleted;
+    }
+
+    // up to the largest window the trace can reach; each lookup samples over
+    // the window live at that point
+    ZipfianGenerator *zipf = NULL;
+    if (spec.distribution == kZipfianKeys)
+    {
+        zipf = new ZipfianGenerator(std::max<uint64_t>(num_keys + inserted, 1), spec.zipf_theta);
+    }
+
+    // pass 2: keys, with the live window [oldest, newest) tracked per chunk
+    uint64_t *keys = num_ops ? &trace.keys[num_keys] : NULL;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t c = 0; c < (int64_t)num_chunks; c++)
+    {
+        SplitMix64 rng(Mix64(spec.seed ^ (2 * c + 2)));
+        uint64_t newest = num_keys + chunk_inserts[c];
+        uint64_t oldest = chunk_deletes[c];
+        const uint64_t end = std::min<uint64_t>((c + 1) * kChunkOps, num_ops);
+        for (uint64_t i = c * kChunkOps; i < end; i++)
+        {
+            uint64_t index;
+            if (ops[i] == kTraceInsert)
+            {
+                index = newest++;
+            }
+            else if (ops[i] == kTraceDelete)
+            {
+                index = oldest++;
+            }
+            else if (oldest >= newest || rng.NextDouble() < spec.negative_ratio)
+            {
+                // a miss
+                index = kNegativeBase + rng.Next() % kNegativeBase;
+            }
+            else
+            {
+                const uint64_t live = newest - oldest;
+                uint64_t rank;
+                if (spec.distribution == kZipfianKeys)
+                {
+                    rank = zipf->Next(rng, live);
+                }
+                else if (spec.distribution == kHotSetKeys)
+                {
+                    const uint64_t hot = std::max<uint64_t>((uint64_t)(live * spec.hot_fraction), 1);
+                    rank = rng.NextDouble() < spec.hot_probability || hot == live ? rng.NextBelow(hot)
+                                                                                   : hot + rng.NextBelow(live - hot);
+                }
+                else
+                {
+                    rank = rng.NextBelow(live);
+                }
+                index = newest - 1 - rank;
+            }
+            keys[i] = Mix64(spec.seed + index);
+        }
+    }
+    delete zipf;
+}
+
+// File: "BFTRACE1", uint64 op count, the keys (uint64 each), then the ops
+// (one byte each, a TraceOp), all little-endian. Traces recorded elsewhere
+// store a 64-bit hash or id of each key. ReadTrace rejects any other op.
+static const char kTraceMagic[8] = {'B', 'F', 'T', 'R', 'A', 'C', 'E', '1'};
+
+void WriteTrace(const char *path, const Trace &trace)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        throw std::runtime_error(std::string("cannot write trace ") + path);
+    }
+    const uint64_t n = trace.ops.size();
+    bool ok = fwrite(kTraceMagic, sizeof(kTraceMagic), 1, f) == 1 && fwrite(&n, sizeof(n), 1, f) == 1;
+    ok = ok && (!n || (fwrite(&trace.keys[0], sizeof(uint64_t), n, f) == n && fwrite(&trace.ops[0], 1, n, f) == n));
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+    {
+        throw std::runtime_error(std::string("short write to trace ") + path);
+    }
+}
+
+void ReadTrace(const char *path, Trace &trace)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        throw std::runtime_error(std::string("cannot read trace ") + path);
+    }
+    char magic[sizeof(kTraceMagic)];
+    uint64_t n = 0;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, kTraceMagic, sizeof(magic)) &&
+              fread(&n, sizeof(n), 1, f) == 1;
+    if (ok)
+    {
+        trace.keys.resize(n);
+        trace.ops.resize(n);
+        ok = !n || (fread(&trace.keys[0], sizeof(uint64_t), n, f) == n && fread(&trace.ops[0], 1, n, f) == n);
+    }
+    fclose(f);
+    if (!ok)
+    {
+        throw std::runtime_error(std::string("not a trace file: ") + path);
+    }
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (trace.ops[i] > kTraceDelete)
+        {
+            throw std::runtime_error(std::string("unknown op in trace ") + path);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+#include "baselines/blockedbloom.hpp"
+#include "baselines/cuckoofilter.hpp"
+#include "baselines/dynamiccuckoo.hpp"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+template <typename Filter>
+Filter *MakeFilter(uint64_t capacity)
+{
+    return new Filter(capacity);
+}
+
+template <>
+BambooFilter *MakeFilter<BambooFilter>(uint64_t capacity)
+{
+    return new BambooFilter(capacity, 2);
+}
+
+// One row of the comparison: throughput in Mops/s, FPR over keys never
+// inserted, bits per inserted key, and how many inserts the filter rejected.
+// Every key an insert accepted must be found again.
+template <typename Filter>
+void Run(const char *name, bool supports_delete, uint64_t capacity, size_t add_count,
+         const vector<string> &to_add, const vector<string> &to_lookup)
+{
+    Filter *filter = MakeFilter<Filter>(capacity);
+
+    size_t failed = 0;
+    vector<char> stored(add_count);
+    auto start_time = NowNanos();
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        stored[added] = filter->Insert(to_add[added].c_str());
+        failed += !stored[added];
+    }
+    double insert_mops = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+    start_time = NowNanos();
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        if (!filter->Lookup(to_add[added].c_str()) && stored[added])
+        {
+            throw logic_error(string("False Negative in ") + name);
+        }
+    }
+    double pos_mops = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+    size_t false_positives = 0;
+    start_time = NowNanos();
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        false_positives += filter->Lookup(to_lookup[added].c_str());
+    }
+    double neg_mops = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+    double bits_per_key = filter->SizeInBytes() * 8.0 / add_count;
+
+    cout << name << "\t" << add_count << "\t" << failed << "\t" << bits_per_key << "\t"
+         << insert_mops << "\t" << pos_mops << "\t" << neg_mops << "\t"
+         << (false_positives * 1.0 / add_count) << "\t";
+
+    if (supports_delete)
+    {
+        start_time = NowNanos();
+        for (uint64_t added = 0; added < add_count; added++)
+        {
+            filter->Delete(to_add[added].c_str());
+        }
+        cout << ((add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)) << endl;
+    }
+    else
+    {
+        cout << "-" << endl;
+    }
+
+    delete filter;
+}
+
+// Bamboo filter against the standard, blocked-Bloom and dynamic cuckoo
+// baselines. All filters are sized for the first step and then fed up to 7x
+// that many keys, so the fixed-size ones degrade (FPR or rejected inserts)
+// while the dynamic ones grow.
+int main(int argc, char *argv[])
+{
+    size_t base_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+    size_t add_count = base_count * 7;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+    cout << "filter\titems\tfailed\tbits/key\tinsert\tpos_lookup\tneg_lookup\tfpr\tdelete" << endl;
+
+    uint64_t capacity = upperpower2(base_count);
+    for (auto exp_idx = 1; exp_idx <= 7; exp_idx++)
+    {
+        auto add_count = exp_idx * base_count;
+
+        Run<BambooFilter>("BBF", true, capacity, add_count, to_add, to_lookup);
+        Run<CuckooFilter>("CF", CuckooFilter::kSupportsDelete, capacity, add_count, to_add, to_lookup);
+        Run<BlockedBloomFilter>("BBloom", BlockedBloomFilter::kSupportsDelete, capacity, add_count, to_add, to_lookup);
+        Run<DynamicCuckooFilter>("DCF", DynamicCuckooFilter::kSupportsDelete, capacity, add_count, to_add, to_lookup);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Fills filters capped at a fraction of the memory an uncapped filter ends up
+// using, then compares size, tag width, rejected inserts and false positive
+// rate (measured and EffectiveFpr) after all inserts, and again after
+// deleting half the keys. Every accepted key must be found, and a filter that
+// rejected inserts must not have grown past its cap afterwards.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t init_size = upperpower2(add_count / 16);
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    BambooFilter *uncapped = new BambooFilter(init_size, 2);
+    for (size_t i = 0; i < add_count; i++)
+    {
+        uncapped->Insert(to_add[i].c_str());
+    }
+    const uint64_t full_size = uncapped->SizeInBytes();
+    delete uncapped;
+
+    cout << "cap\tbytes\tbits/key\ttag bits\trejected\tFPR\testimated\tinsert Mops" << endl;
+    const double caps[] = {0, 0.8, 0.6, 0.3};
+    for (size_t c = 0; c < sizeof(caps) / sizeof(caps[0]); c++)
+    {
+        BambooFilter *bf = new BambooFilter(init_size, 2);
+        bf->SetMemoryBudget((uint64_t)(full_size * caps[c]));
+
+        vector<char> stored(add_count);
+        size_t rejected = 0;
+        uint64_t size_at_first_rejection = 0;
+        auto start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            stored[i] = bf->Insert(to_add[i].c_str());
+            if (!stored[i] && !rejected++)
+            {
+                size_at_first_rejection = bf->SizeInBytes();
+            }
+        }
+        double insert_mops = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+        if (rejected && bf->SizeInBytes() > size_at_first_rejection)
+        {
+            throw logic_error("Filter grew while rejecting inserts");
+        }
+
+        for (int deleted = 0; deleted < 2; deleted++)
+        {
+            for (size_t i = deleted ? add_count / 2 : 0; i < add_count; i++)
+            {
+                if (stored[i] && !bf->Lookup(to_add[i].c_str()))
+                {
+                    throw logic_error("False Negative");
+                }
+            }
+            size_t false_queries = 0;
+            for (size_t i = 0; i < add_count; i++)
+            {
+                false_queries += bf->Lookup(to_lookup[i].c_str());
+            }
+            cout << caps[c] << (deleted ? " -50%" : "") << "\t" << bf->SizeInBytes() << "\t"
+                 << (bf->SizeInBytes() * 8.0 / bf->num_items_) << "\t" << bf->TagBits() << "\t" << rejected << "\t"
+                 << (false_queries * 1.0 / add_count) << "\t" << bf->EffectiveFpr() << "\t" << insert_mops << endl;
+
+            if (!deleted)
+            {
+                for (size_t i = 0; i < add_count / 2; i++)
+                {
+                    if (stored[i] && !bf->Delete(to_add[i].c_str()))
+                    {
+                        throw logic_error("Delete of an inserted key failed");
+                    }
+                }
+            }
+        }
+        delete bf;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Chain-length budget policy: fills filters under several max_avg_scan budgets
+// and checks that the average lookup scan settles within the budget, then
+// deletes the keys back down. Every Compress must leave a table that, packed,
+// scans at most half the budget, and inserting and deleting one key right
+// after a Compress must not split and merge the same segments again.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count + 1, to_add, to_lookup);
+    const char *churn_key = to_add[add_count].c_str();
+
+    cout << "Begin test" << endl;
+    cout << "budget\tsegments\tavg scan\tpeak scan\tbits/key\tinsert Mops\tcompresses" << endl;
+
+    const double budgets[] = {4, 6, 8};
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+    {
+        const double budget = budgets[b];
+        BambooFilter *bf = new BambooFilter(upperpower2(add_count / 16), 2);
+        bf->SetChainBudget(budget);
+
+        // one Extend per insert: the average may overshoot by the growth of
+        // the chains that triggered it, but must come back within the budget
+        double peak_scan = 0;
+        auto start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            bf->Insert(to_add[i].c_str());
+            peak_scan = max(peak_scan, bf->AvgBucketsScanned());
+        }
+        double insert_mops = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+        if (bf->AvgBucketsScanned() > budget)
+        {
+            throw logic_error("Average scan over the chain budget");
+        }
+        for (size_t i = 0; i < add_count; i++)
+        {
+            if (!bf->Lookup(to_add[i].c_str()))
+            {
+                throw logic_error("False Negative");
+            }
+        }
+        const uint64_t full_segments = bf->hash_table_.size();
+        const double full_scan = bf->AvgBucketsScanned();
+        const double bits_per_key = bf->SizeInBytes() * 8.0 / add_count;
+
+        size_t compresses = 0;
+        for (size_t i = 0; i < add_count; i++)
+        {
+            const uint64_t segments = bf->hash_table_.size();
+            if (!bf->Delete(to_add[i].c_str()))
+            {
+                throw logic_error("Delete of an inserted key failed");
+            }
+            if (bf->hash_table_.size() == segments)
+            {
+                continue;
+            }
+            compresses++;
+            const double packed_scan = 2.0 * bf->num_items_ / (bf->hash_table_.size() * (1ULL << BUCKETS_PER_SEG) * 4);
+            if (packed_scan > budget / 2)
+            {
+                throw logic_error("Compress above half the chain budget");
+            }
+            const uint64_t merged = bf->hash_table_.size();
+            for (int round = 0; round < 16; round++)
+            {
+                bf->Insert(churn_key);
+                bf->Delete(churn_key);
+            }
+            if (bf->hash_table_.size() != merged)
+            {
+                throw logic_error("Split and merge without hysteresis");
+            }
+        }
+
+        cout << budget << "\t" << full_segments << "\t" << full_scan << "\t" << peak_scan << "\t" << bits_per_key
+             << "\t" << insert_mops << "\t" << compresses << endl;
+        delete bf;
+    }
+    return 0;
+}
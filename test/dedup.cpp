@@ -0,0 +1,94 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+#include "common/workload.h"
+
+using namespace std;
+
+// At-least-once ingest: a stream in which dup_rate of the keys resend a key
+// already in the stream. Insert stores every copy; InsertIfAbsent stores each
+// key once. Compares throughput, memory per distinct key and the false
+// positive rate, and checks that no key is lost.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    double dup_rate = argc > 2 ? atof(argv[2]) : 0.3;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    // stream of indices into to_add: every distinct key once, plus resends of
+    // keys sent earlier
+    const size_t stream_size = add_count / (1 - dup_rate);
+    vector<uint32_t> stream;
+    stream.reserve(stream_size);
+    SplitMix64 rng(1);
+    size_t next_new = 0;
+    while (stream.size() < stream_size)
+    {
+        if (next_new == 0 || (next_new < add_count && rng.NextDouble() >= dup_rate))
+        {
+            stream.push_back(next_new++);
+        }
+        else
+        {
+            stream.push_back(rng.NextBelow(next_new));
+        }
+    }
+
+    cout << "Begin test" << endl;
+    cout << "stream " << stream.size() << " keys, " << next_new << " distinct" << endl;
+    cout << "insert\tMops\tbits/key\tsegments\tstored\tFPR" << endl;
+
+    for (int if_absent = 0; if_absent < 2; if_absent++)
+    {
+        BambooFilter *bbf = new BambooFilter(upperpower2(add_count / 4), 2);
+
+        auto start_time = NowNanos();
+        for (size_t i = 0; i < stream.size(); i++)
+        {
+            const char *key = to_add[stream[i]].c_str();
+            if (if_absent)
+            {
+                bbf->InsertIfAbsent(key);
+            }
+            else
+            {
+                bbf->Insert(key);
+            }
+        }
+        double mops = (stream.size() * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+        for (size_t i = 0; i < next_new; i++)
+        {
+            if (!bbf->Lookup(to_add[i].c_str()))
+            {
+                throw logic_error("False Negative");
+            }
+        }
+        size_t false_positives = 0;
+        for (size_t i = 0; i < add_count; i++)
+        {
+            false_positives += bbf->Lookup(to_lookup[i].c_str());
+        }
+
+        cout << (if_absent ? "InsertIfAbsent" : "Insert") << "\t" << mops << "\t"
+             << (bbf->SizeInBytes() * 8.0 / next_new) << "\t" << bbf->hash_table_.size() << "\t"
+             << bbf->num_items_ << "\t" << (double)false_positives / add_count << endl;
+        delete bbf;
+    }
+
+    return 0;
+}
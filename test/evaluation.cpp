@@ -18,6 +18,7 @@
 #include "bamboofilter/bamboofilter.hpp"
 #include "bamboofilter/bitsutil.h"
 
+#include "common/perf_counters.h"
 #include "common/random.h"
 #include "common/timing.h"
 
@@ -34,24 +35,50 @@ int main(int argc, char *argv[])
     vector<string> to_add, to_lookup;
     GenerateRandom64(add_count, to_add, to_lookup);
 
+    // hardware counters per op of each phase; "-" where unavailable
+    PerfCounters counters;
+    if (!counters.Error().empty())
+    {
+        cout << "some counters unavailable (" << counters.Error() << ")" << endl;
+    }
+
     cout << "Begin test" << endl;
+    cout << "items\tphase\tMops\t";
+    PerfCounters::PrintHeader(cout);
+    cout << endl;
 
     for (auto exp_idx = 1; exp_idx <= 7; exp_idx++)
     {
         auto add_count = exp_idx * 200000;
 
         BambooFilter *bbf = new BambooFilter(upperpower2(200000), 2);
-        for (uint64_t added = 0; added < add_count; added++)
-        {
-            bbf->Insert(to_add[added].c_str());
-        }
-
-        auto start_time = NowNanos();
-        for (uint64_t added = 0; added < add_count; added++)
+        for (int phase = 0; phase < 3; phase++)
         {
-            bbf->Lookup(to_add[added].c_str());
+            static const char *const names[3] = {"insert", "lookup", "delete"};
+            auto start_time = NowNanos();
+            counters.Start();
+            for (uint64_t added = 0; added < add_count; added++)
+            {
+                if (phase == 0)
+                {
+                    bbf->Insert(to_add[added].c_str());
+                }
+                else if (phase == 1)
+                {
+                    bbf->Lookup(to_add[added].c_str());
+                }
+                else
+                {
+                    bbf->Delete(to_add[added].c_str());
+                }
+            }
+            counters.Stop();
+            cout << add_count << "\t" << names[phase] << "\t"
+                 << ((add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)) << "\t";
+            counters.PrintPerOp(cout, add_count);
+            cout << endl;
         }
-        cout << ((add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)) << endl;
+        delete bbf;
     }
 
     return 0;
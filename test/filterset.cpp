@@ -0,0 +1,98 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/filter_set.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// LSM-style point lookups: the keys are spread over num_runs filters of
+// growing size, and every lookup probes all of them, once filter by filter
+// and once through a FilterSet.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint32_t num_runs = argc > 2 ? atoi(argv[2]) : 20;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    // run r holds keys [bounds[r], bounds[r + 1]); later runs are larger
+    vector<size_t> bounds(num_runs + 1, 0);
+    for (uint32_t r = 1; r <= num_runs; r++)
+    {
+        bounds[r] = add_count * r * (r + 1) / (num_runs * (num_runs + 1));
+    }
+    vector<BambooFilter *> runs;
+    FilterSet set;
+    for (uint32_t r = 0; r < num_runs; r++)
+    {
+        size_t run_size = bounds[r + 1] - bounds[r];
+        // BambooFilter needs at least two segments
+        runs.push_back(new BambooFilter(upperpower2(run_size / 4 > 8192 ? run_size / 4 : 8192), 2));
+        for (size_t i = bounds[r]; i < bounds[r + 1]; i++)
+        {
+            runs[r]->Insert(to_add[i].c_str());
+        }
+        set.Add(runs[r]);
+    }
+
+    cout << "Begin test" << endl;
+
+    for (uint32_t r = 0; r < num_runs; r++)
+    {
+        for (size_t i = bounds[r]; i < bounds[r + 1]; i++)
+        {
+            if (!(set.Lookup(to_add[i].c_str()) >> r & 1))
+            {
+                throw logic_error("False Negative");
+            }
+        }
+    }
+
+    for (int positive = 1; positive >= 0; positive--)
+    {
+        vector<string> &keys = positive ? to_add : to_lookup;
+        uint64_t hits = 0;
+        auto start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            for (uint32_t r = 0; r < num_runs; r++)
+            {
+                hits += runs[r]->Lookup(keys[i].c_str());
+            }
+        }
+        double separate = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+        uint64_t set_hits = 0;
+        start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            set_hits += __builtin_popcountll(set.Lookup(keys[i].c_str()));
+        }
+        double together = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+        if (hits != set_hits)
+        {
+            throw logic_error("FilterSet disagrees with its members");
+        }
+
+        cout << (positive ? "positive" : "negative") << " keys, " << num_runs << " filters: "
+             << separate << " Mkeys/s one by one, " << together << " Mkeys/s with FilterSet" << endl;
+    }
+
+    for (uint32_t r = 0; r < num_runs; r++)
+    {
+        delete runs[r];
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/frozen_bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Builds a filter, freezes it with plain and with semi-sorted packing, and
+// compares memory per key and lookup throughput; both frozen filters must
+// answer every query like the live one.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t init_size = upperpower2(add_count / 4);
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    BambooFilter *bf = new BambooFilter(init_size, 2);
+    for (size_t i = 0; i < add_count; i++)
+    {
+        bf->Insert(to_add[i].c_str());
+    }
+
+    FrozenBambooFilter *frozen[2];
+    for (int semi_sorted = 0; semi_sorted < 2; semi_sorted++)
+    {
+        auto start_time = NowNanos();
+        frozen[semi_sorted] = new FrozenBambooFilter(*bf, semi_sorted);
+        cout << "freeze" << (semi_sorted ? " (semi-sorted)" : "") << ": " << (NowNanos() - start_time) / 1e6 << " ms" << endl;
+
+        for (size_t i = 0; i < add_count; i++)
+        {
+            if (!frozen[semi_sorted]->Lookup(to_add[i].c_str()))
+            {
+                throw logic_error("False Negative");
+            }
+            if (frozen[semi_sorted]->Lookup(to_lookup[i].c_str()) != bf->Lookup(to_lookup[i].c_str()))
+            {
+                throw logic_error("Frozen filter disagrees with the live filter");
+            }
+        }
+    }
+
+    cout << "filter\tbits/key\tpositive Mops\tnegative Mops" << endl;
+    const char *names[3] = {"live", "frozen", "semi-sorted"};
+    for (int f = 0; f < 3; f++)
+    {
+        size_t found = 0;
+        auto start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            found += f ? frozen[f - 1]->Lookup(to_add[i].c_str()) : bf->Lookup(to_add[i].c_str());
+        }
+        double positive = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+        start_time = NowNanos();
+        for (size_t i = 0; i < add_count; i++)
+        {
+            found += f ? frozen[f - 1]->Lookup(to_lookup[i].c_str()) : bf->Lookup(to_lookup[i].c_str());
+        }
+        double negative = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+        uint64_t bytes = f ? frozen[f - 1]->SizeInBytes() : bf->SizeInBytes();
+        cout << names[f] << "\t" << (bytes * 8.0 / add_count) << "\t"
+             << positive << "\t" << negative << "\t(" << found << " found)" << endl;
+    }
+
+    delete frozen[0];
+    delete frozen[1];
+    delete bf;
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "bamboofilter/buffered_bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Concurrent ingest through BufferedBambooFilter from 1 to max_threads
+// threads, doubling: once with a buffer of 1 (every insert takes the write
+// lock) and once with write-combining buffers. Every key must be visible
+// after the writers flush, also to max_threads concurrent readers.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 64;
+    uint32_t buffer_size = argc > 3 ? atoi(argv[3]) : BufferedBambooFilter::kDefaultBufferSize;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    // a writer sees its own buffered inserts before they are flushed
+    {
+        BufferedBambooFilter bf(upperpower2(add_count / 4), 2);
+        BufferedBambooFilter::Writer writer(bf, 1024);
+        writer.Insert(to_add[0].c_str());
+        writer.Insert(to_add[1].c_str());
+        if (!writer.Lookup(to_add[0].c_str()) || bf.Lookup(to_add[0].c_str()))
+        {
+            throw logic_error("Buffered insert visible to the wrong thread");
+        }
+        if (!writer.Delete(to_add[0].c_str()) || writer.Lookup(to_add[0].c_str()))
+        {
+            throw logic_error("Buffered delete failed");
+        }
+        writer.Flush();
+        if (!bf.Lookup(to_add[1].c_str()) || bf.NumItems() != 1)
+        {
+            throw logic_error("False Negative");
+        }
+    }
+
+    cout << "threads\tlocked Mops\tbuffered Mops" << endl;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double mops[2];
+        for (int buffered = 0; buffered < 2; buffered++)
+        {
+            BufferedBambooFilter *bf = new BufferedBambooFilter(upperpower2(add_count / 4), 2);
+            auto start_time = NowNanos();
+#pragma omp parallel num_threads(threads)
+            {
+                BufferedBambooFilter::Writer writer(*bf, buffered ? buffer_size : 1);
+                const size_t begin = add_count * omp_get_thread_num() / omp_get_num_threads();
+                const size_t end = add_count * (omp_get_thread_num() + 1) / omp_get_num_threads();
+                for (size_t i = begin; i < end; i++)
+                {
+                    writer.Insert(to_add[i].c_str());
+                }
+            }
+            mops[buffered] = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+            for (size_t i = 0; i < add_count; i++)
+            {
+                if (!bf->Lookup(to_add[i].c_str()))
+                {
+                    throw logic_error("False Negative");
+                }
+            }
+            delete bf;
+        }
+        cout << threads << "\t" << mops[0] << "\t" << mops[1] << endl;
+    }
+
+    // readers share the read lock; a split condition above 2 leaves segments
+    // with chains longer than the short-chain lookup kernels
+    {
+        BufferedBambooFilter bf(upperpower2(add_count / 4), 4);
+        {
+            BufferedBambooFilter::Writer writer(bf);
+            for (size_t i = 0; i < add_count; i++)
+            {
+                writer.Insert(to_add[i].c_str());
+            }
+        }
+        size_t misses = 0;
+        auto start_time = NowNanos();
+#pragma omp parallel num_threads(max_threads) reduction(+ : misses)
+        {
+            for (size_t i = omp_get_thread_num(); i < add_count; i += omp_get_num_threads())
+            {
+                misses += !bf.Lookup(to_add[i].c_str());
+            }
+        }
+        cout << max_threads << " readers\t" << (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)
+             << " Mops" << endl;
+        if (misses)
+        {
+            throw logic_error("False Negative");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <string>
+#include <iostream>
+#include <random>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/segment.hpp"
+#include "bamboofilter/bitsutil.h"
+
+using namespace std;
+
+static const uint32_t kChains = 1 << BUCKETS_PER_SEG;
+static const uint32_t kSlots = 4;
+
+static char *Bucket(char *data, uint32_t stride, uint32_t chain, uint32_t bucket)
+{
+    return data + chain * stride + bucket * Segment::BucketBytes();
+}
+
+static void PutTag(char *bucket, uint32_t slot, uint16_t tag)
+{
+    uint16_t *p = (uint16_t *)(bucket + slot + (slot >> 1));
+    if (slot & 1)
+    {
+        *p = (*p & 0x000f) | (tag << 4);
+    }
+    else
+    {
+        *p = (*p & 0xf000) | tag;
+    }
+}
+
+static uint16_t GetTag(const char *bucket, uint32_t slot)
+{
+    uint16_t v = *(const uint16_t *)(bucket + slot + (slot >> 1));
+    return (v >> ((slot & 1) << 2)) & ((1 << BITS_PER_TAG) - 1);
+}
+
+// Scalar reference: reads every slot of the chain and of its partner chain.
+static bool ScalarLookup(char *data, uint32_t capacity, uint32_t stride, uint32_t chain, uint16_t tag)
+{
+    const uint32_t alt = (chain ^ tag) & (kChains - 1);
+    for (uint32_t b = 0; b < capacity; b++)
+    {
+        for (uint32_t s = 0; s < kSlots; s++)
+        {
+            if (GetTag(Bucket(data, stride, chain, b), s) == tag || GetTag(Bucket(data, stride, alt, b), s) == tag)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Checks Segment::LookupChains against a scalar scan for chain capacities on
+// both sides of the fixed-capacity kernels (1-4, including the odd ones whose
+// last two buckets are compared twice) and the copying kernel behind them, in
+// the packed and the cache-aligned chain layouts. Bytes outside the tags are
+// random, so a kernel that compares padding shows up as a mismatch.
+int main(int argc, char *argv[])
+{
+    size_t queries = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+    mt19937_64 rng(argc > 2 ? strtoull(argv[2], NULL, 10) : 1);
+
+    cout << "capacity\tlayout\tstride\thits\tmisses" << endl;
+    for (uint32_t capacity = 1; capacity <= 9; capacity++)
+    {
+        for (int aligned = 0; aligned <= 1; aligned++)
+        {
+            uint32_t stride = capacity * Segment::BucketBytes();
+            if (aligned)
+            {
+                const uint32_t len = stride + sizeof(uint64_t) - Segment::BucketBytes();
+                stride = len <= 64 ? upperpower2(len) : (len + 63) / 64 * 64;
+            }
+
+            vector<char> data(kChains * stride + sizeof(uint64_t));
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                data[i] = (char)rng();
+            }
+            // a quarter of the slots empty, the rest drawn from a small set of
+            // tags so that lookups hit at every position of the chains
+            for (uint32_t c = 0; c < kChains; c++)
+            {
+                for (uint32_t b = 0; b < capacity; b++)
+                {
+                    for (uint32_t s = 0; s < kSlots; s++)
+                    {
+                        uint16_t tag = rng() % 4 ? 1 + rng() % 255 : 0;
+                        PutTag(Bucket(data.data(), stride, c, b), s, tag);
+                    }
+                }
+            }
+
+            size_t hits = 0;
+            for (size_t q = 0; q < queries; q++)
+            {
+                const uint32_t chain = rng() % kChains;
+                uint16_t tag;
+                if (q & 1)
+                {
+                    tag = 1 + rng() % ((1 << BITS_PER_TAG) - 1);
+                }
+                else
+                {
+                    tag = GetTag(Bucket(data.data(), stride, chain, rng() % capacity), rng() % kSlots);
+                    tag = tag ? tag : 1;
+                }
+
+                const bool expected = ScalarLookup(data.data(), capacity, stride, chain, tag);
+                if (Segment::LookupChains(data.data(), capacity, stride, chain, tag) != expected)
+                {
+                    throw logic_error("Kernel mismatch at capacity " + to_string(capacity) + ", chain " +
+                                      to_string(chain) + ", tag " + to_string(tag));
+                }
+                hits += expected;
+            }
+
+            cout << capacity << "\t" << (aligned ? "aligned" : "packed") << "\t" << stride << "\t" << hits
+                 << "\t" << queries - hits << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/latency.h"
+#include "common/random.h"
+
+using namespace std;
+
+// Per-operation latency (TSC cycles) of Insert, Lookup and Delete, including
+// the inserts that grow a chain or Extend the table and the deletes that
+// Compress it. Each thread drives its own filter; histograms are merged.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000 * 7;
+    int num_threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    vector<thread> workers;
+    for (int t = 0; t < num_threads; t++)
+    {
+        workers.push_back(thread([&, t]() {
+            size_t begin = add_count * t / num_threads;
+            size_t end = add_count * (t + 1) / num_threads;
+
+            // at least a few initial segments, so Compress has room to shrink
+            BambooFilter *bbf = new BambooFilter(max(upperpower2((end - begin) / 7), (uint64_t)1 << 14), 2);
+            for (size_t i = begin; i < end; i++)
+            {
+                bbf->Insert(to_add[i].c_str());
+            }
+            for (size_t i = begin; i < end; i++)
+            {
+                bbf->Lookup(to_add[i].c_str());
+                bbf->Lookup(to_lookup[i].c_str());
+            }
+            for (size_t i = begin; i < end; i++)
+            {
+                bbf->Delete(to_add[i].c_str());
+            }
+            delete bbf;
+        }));
+    }
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+
+    LatencyHistogramSet merged;
+    CollectLatency(merged);
+    merged.Print(cout, argc > 3);
+
+    return 0;
+}
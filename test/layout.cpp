@@ -0,0 +1,113 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/perf_counters.h"
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Packed vs. cache-line-aligned chain layout: memory per key and false
+// positive rate against insert and lookup throughput (Mops/s) and hardware
+// counters per operation (cache and TLB misses, "-" where unavailable) as the
+// filter grows through several Extend rounds.
+int main(int argc, char *argv[])
+{
+    size_t base_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+    size_t add_count = base_count * 7;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    PerfCounters counters;
+    if (!counters.Error().empty())
+    {
+        cout << "some counters unavailable (" << counters.Error() << ")" << endl;
+    }
+
+    cout << "Begin test" << endl;
+    cout << "layout\titems\tbits/key\tfpr\tphase\tMops\t";
+    PerfCounters::PrintHeader(cout);
+    cout << endl;
+
+    for (auto exp_idx = 1; exp_idx <= 7; exp_idx++)
+    {
+        auto add_count = exp_idx * base_count;
+
+        for (int aligned = 0; aligned <= 1; aligned++)
+        {
+            BambooFilter *bbf = new BambooFilter(upperpower2(base_count), 2, aligned);
+
+            // insert, positive lookup, negative lookup, delete
+            static const char *const names[4] = {"insert", "pos_lookup", "neg_lookup", "delete"};
+            double mops[4];
+            ostringstream per_op[4];
+            double bits_per_key = 0;
+            size_t found = 0;
+            for (int phase = 0; phase < 4; phase++)
+            {
+                auto start_time = NowNanos();
+                counters.Start();
+                switch (phase)
+                {
+                case 0:
+                    for (uint64_t added = 0; added < add_count; added++)
+                    {
+                        bbf->Insert(to_add[added].c_str());
+                    }
+                    break;
+                case 1:
+                    for (uint64_t added = 0; added < add_count; added++)
+                    {
+                        if (!bbf->Lookup(to_add[added].c_str()))
+                        {
+                            throw logic_error("False Negative");
+                        }
+                    }
+                    break;
+                case 2:
+                    for (uint64_t added = 0; added < add_count; added++)
+                    {
+                        found += bbf->Lookup(to_lookup[added].c_str());
+                    }
+                    break;
+                default:
+                    for (uint64_t added = 0; added < add_count; added++)
+                    {
+                        bbf->Delete(to_add[added].c_str());
+                    }
+                    break;
+                }
+                counters.Stop();
+                mops[phase] = (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time);
+                counters.PrintPerOp(per_op[phase], add_count);
+                if (phase == 0)
+                {
+                    bits_per_key = bbf->SizeInBytes() * 8.0 / add_count;
+                }
+            }
+
+            const double fpr = static_cast<double>(found) / add_count;
+            for (int phase = 0; phase < 4; phase++)
+            {
+                cout << (aligned ? "aligned" : "packed") << "\t" << add_count << "\t" << bits_per_key << "\t"
+                     << fpr << "\t" << names[phase] << "\t" << mops[phase] << "\t" << per_op[phase].str() << endl;
+            }
+
+            delete bbf;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/filter_server.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Load generator for FilterServer. Preloads add_count keys, then runs 1 to
+// max_clients client threads, doubling, each with its own connection and
+// depth requests in flight, looking up inserted and absent keys in turn.
+// Reports throughput, p50 and p99 latency, and the server's average batch.
+// Without a socket path, a server runs in this process on a thread.
+//   loadgen [keys] [max clients] [requests per client] [depth] [socket path]
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    int max_clients = argc > 2 ? atoi(argv[2]) : 64;
+    size_t num_requests = argc > 3 ? strtoull(argv[3], NULL, 10) : 20000;
+    uint32_t depth = argc > 4 ? atoi(argv[4]) : 1;
+    const char *path = argc > 5 ? argv[5] : "/tmp/bamboofilter_loadgen.sock";
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    FilterServer *server = NULL;
+    thread server_thread;
+    if (argc <= 5)
+    {
+        server = new FilterServer(path, upperpower2(add_count / 4), 2);
+        server_thread = thread([server]() { server->Run(); });
+    }
+
+    cout << "Begin test" << endl;
+
+    {
+        FilterClient client(path);
+        const size_t kPreloadBatch = 1024;
+        for (size_t i = 0; i < add_count; i += kPreloadBatch)
+        {
+            const size_t end = min(add_count, i + kPreloadBatch);
+            for (size_t j = i; j < end; j++)
+            {
+                client.Send(kOpInsert, j, to_add[j].c_str(), to_add[j].size());
+            }
+            client.Flush();
+            for (size_t j = i; j < end; j++)
+            {
+                uint32_t id;
+                uint8_t result;
+                client.Receive(id, result);
+            }
+        }
+    }
+
+    cout << "clients\tdepth\tMops\tp50 us\tp99 us\tbatch" << endl;
+    for (int clients = 1; clients <= max_clients; clients *= 2)
+    {
+        vector<vector<uint64_t> > latencies(clients);
+        const uint64_t batches = server ? server->NumBatches() : 0;
+        const uint64_t requests = server ? server->NumRequests() : 0;
+        auto start_time = NowNanos();
+
+        vector<thread> workers;
+        for (int c = 0; c < clients; c++)
+        {
+            workers.push_back(thread([&, c]() {
+                FilterClient client(path);
+                vector<uint64_t> &lat = latencies[c];
+                vector<uint64_t> sent_at(depth);
+                lat.reserve(num_requests);
+                size_t next = 0;
+                // request i looks up inserted key k if i is even, an absent one if odd
+                auto send = [&](size_t i) {
+                    const size_t k = (c * num_requests + i / 2) % add_count;
+                    const string &key = i % 2 ? to_lookup[k] : to_add[k];
+                    sent_at[i % depth] = NowNanos();
+                    client.Send(kOpLookup, i, key.c_str(), key.size());
+                };
+                for (; next < depth && next < num_requests; next++)
+                {
+                    send(next);
+                }
+                client.Flush();
+                for (size_t done = 0; done < num_requests; done++)
+                {
+                    uint32_t id;
+                    uint8_t result;
+                    client.Receive(id, result);
+                    lat.push_back(NowNanos() - sent_at[id % depth]);
+                    if (id % 2 == 0 && !result)
+                    {
+                        throw logic_error("False Negative");
+                    }
+                    if (next < num_requests)
+                    {
+                        send(next++);
+                        client.Flush();
+                    }
+                }
+            }));
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+        const double mops = (clients * num_requests * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+        vector<uint64_t> all;
+        for (int c = 0; c < clients; c++)
+        {
+            all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        }
+        sort(all.begin(), all.end());
+        cout << clients << "\t" << depth << "\t" << mops << "\t" << all[all.size() / 2] / 1e3 << "\t"
+             << all[all.size() * 99 / 100] / 1e3 << "\t";
+        if (server)
+        {
+            cout << (double)(server->NumRequests() - requests) / (server->NumBatches() - batches);
+        }
+        else
+        {
+            cout << "-";
+        }
+        cout << endl;
+    }
+
+    if (server)
+    {
+        server->Stop();
+        server_thread.join();
+        delete server;
+    }
+    return 0;
+}
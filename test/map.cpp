@@ -0,0 +1,77 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboomap.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/BOBHash.h"
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Key -> shard (4-bit) map: every inserted key must come back with its own
+// shard; keys that were never inserted should mostly be reported absent.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000 * 4;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    vector<uint32_t> shard(add_count);
+    for (size_t i = 0; i < add_count; i++)
+    {
+        shard[i] = BOBHash::run(to_add[i].c_str(), to_add[i].size(), 7) & 15;
+    }
+
+    cout << "Begin test" << endl;
+
+    BambooMap<4> *map = new BambooMap<4>(upperpower2(add_count / 4), 2);
+
+    auto start_time = NowNanos();
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        map->Insert(to_add[added].c_str(), shard[added]);
+    }
+    cout << "insert: " << ((add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)) << endl;
+
+    size_t wrong = 0;
+    start_time = NowNanos();
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        uint32_t value;
+        if (!map->Lookup(to_add[added].c_str(), value))
+        {
+            throw logic_error("False Negative");
+        }
+        wrong += value != shard[added];
+    }
+    cout << "lookup: " << ((add_count * 1000.0) / static_cast<double>(NowNanos() - start_time)) << endl;
+
+    size_t present = 0;
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        uint32_t value;
+        present += map->Lookup(to_lookup[added].c_str(), value);
+    }
+
+    cout << "wrong value rate: " << (wrong * 1.0 / add_count) << endl;
+    cout << "false positive rate: " << (present * 1.0 / add_count) << endl;
+    cout << "bits/key: " << (map->SizeInBytes() * 8.0 / add_count) << endl;
+
+    for (uint64_t added = 0; added < add_count; added++)
+    {
+        map->Delete(to_add[added].c_str());
+    }
+
+    delete map;
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Builds two filters over a 1:3 split of the keys and merges them both ways
+// (smaller into larger and larger into smaller). The merged filter must hold
+// every key and should be about as large and as accurate as one filter built
+// from all keys directly.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    size_t split = add_count / 4;
+    size_t init_size = upperpower2(add_count / 4);
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    BambooFilter *whole = new BambooFilter(init_size, 2);
+    auto start_time = NowNanos();
+    for (size_t i = 0; i < add_count; i++)
+    {
+        whole->Insert(to_add[i].c_str());
+    }
+    cout << "insert all: " << (add_count * 1000.0) / static_cast<double>(NowNanos() - start_time) << endl;
+
+    for (int larger_first = 0; larger_first < 2; larger_first++)
+    {
+        BambooFilter *small = new BambooFilter(init_size, 2);
+        BambooFilter *large = new BambooFilter(init_size, 2);
+        for (size_t i = 0; i < split; i++)
+        {
+            small->Insert(to_add[i].c_str());
+        }
+        for (size_t i = split; i < add_count; i++)
+        {
+            large->Insert(to_add[i].c_str());
+        }
+        BambooFilter *dst = larger_first ? large : small;
+        BambooFilter *src = larger_first ? small : large;
+
+        start_time = NowNanos();
+        dst->Merge(*src);
+        uint64_t merge_ns = NowNanos() - start_time;
+
+        for (size_t i = 0; i < add_count; i++)
+        {
+            if (!dst->Lookup(to_add[i].c_str()))
+            {
+                throw logic_error("False Negative");
+            }
+        }
+        size_t false_queries = 0;
+        for (size_t i = 0; i < add_count; i++)
+        {
+            false_queries += dst->Lookup(to_lookup[i].c_str());
+        }
+
+        cout << (larger_first ? "small into large" : "large into small")
+             << ": merge " << merge_ns / 1e6 << " ms, " << (src->num_items_ * 1000.0) / merge_ns << " Mops"
+             << ", segments " << dst->hash_table_.size() << " (direct " << whole->hash_table_.size() << ")"
+             << ", size " << dst->SizeInBytes() << " (direct " << whole->SizeInBytes() << ")"
+             << ", FPR " << (false_queries * 1.0 / add_count) << endl;
+
+        delete small;
+        delete large;
+    }
+
+    size_t false_queries = 0;
+    for (size_t i = 0; i < add_count; i++)
+    {
+        false_queries += whole->Lookup(to_lookup[i].c_str());
+    }
+    cout << "direct FPR " << (false_queries * 1.0 / add_count) << endl;
+
+    delete whole;
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/perf_counters.h"
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Throughput and hardware counters per operation for each phase of a
+// filter's life: inserts (growing through several Extend rounds), positive
+// and negative lookups, explicit Extends that double the table, and deletes
+// (which Compress it back). Counters the machine does not expose print "-".
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000 * 7;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    PerfCounters counters;
+    if (!counters.Error().empty())
+    {
+        cout << "some counters unavailable (" << counters.Error() << ")" << endl;
+    }
+
+    cout << "Begin test" << endl;
+    cout << "phase\tops\tMops\t";
+    PerfCounters::PrintHeader(cout);
+    cout << endl;
+
+    BambooFilter *bbf = new BambooFilter(max(upperpower2(add_count / 7), (uint64_t)1 << 14), 2);
+    size_t found = 0;
+    for (int phase = 0; phase < 5; phase++)
+    {
+        static const char *const names[5] = {"insert", "pos_lookup", "neg_lookup", "extend", "delete"};
+        const uint64_t ops = phase == 3 ? bbf->hash_table_.size() : add_count;
+
+        auto start_time = NowNanos();
+        counters.Start();
+        switch (phase)
+        {
+        case 0:
+            for (size_t i = 0; i < add_count; i++)
+            {
+                bbf->Insert(to_add[i].c_str());
+            }
+            break;
+        case 1:
+            for (size_t i = 0; i < add_count; i++)
+            {
+                found += bbf->Lookup(to_add[i].c_str());
+            }
+            break;
+        case 2:
+            for (size_t i = 0; i < add_count; i++)
+            {
+                found += bbf->Lookup(to_lookup[i].c_str());
+            }
+            break;
+        case 3:
+            for (uint64_t i = 0; i < ops; i++)
+            {
+                bbf->Extend();
+            }
+            break;
+        default:
+            for (size_t i = 0; i < add_count; i++)
+            {
+                bbf->Delete(to_add[i].c_str());
+            }
+            break;
+        }
+        counters.Stop();
+        const double mops = (ops * 1000.0) / static_cast<double>(NowNanos() - start_time);
+
+        if (phase == 1 && found != add_count)
+        {
+            throw logic_error("False Negative");
+        }
+
+        cout << names[phase] << "\t" << ops << "\t" << mops << "\t";
+        counters.PrintPerOp(cout, ops);
+        cout << endl;
+    }
+    cout << "(" << found << " found)" << endl;
+
+    delete bbf;
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/perf_counters.h"
+#include "common/timing.h"
+#include "common/workload.h"
+
+using namespace std;
+
+// Feeds a trace file (see tracegen and common/workload.h) to a BambooFilter
+// and reports throughput and the outcome of every operation type. The filter
+// is sized for the inserts at the start of the trace, like the other
+// benchmarks size it for their key count.
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "usage: " << argv[0] << " trace [split condition]" << endl;
+        return 1;
+    }
+    uint32_t split_condition = argc > 2 ? atoi(argv[2]) : 2;
+
+    cout << "Prepare..." << endl;
+
+    Trace trace;
+    ReadTrace(argv[1], trace);
+    const size_t num_ops = trace.ops.size();
+    size_t load_count = 0;
+    while (load_count < num_ops && trace.ops[load_count] == kTraceInsert)
+    {
+        load_count++;
+    }
+    const size_t init_size = upperpower2(load_count / 4) > 8192 ? upperpower2(load_count / 4) : 8192;
+
+    cout << "Begin test" << endl;
+
+    // counters per op of the load and run phases; "-" where unavailable
+    PerfCounters counters;
+    ostringstream load_counters, run_counters;
+
+    BambooFilter *bf = new BambooFilter(init_size, split_condition);
+    uint64_t count[3] = {0, 0, 0}, hits[3] = {0, 0, 0};
+    auto start_time = NowNanos();
+    counters.Start();
+    for (size_t i = 0; i < load_count; i++)
+    {
+        bf->InsertHash(BambooFilter::HashKey(&trace.keys[i], sizeof(uint64_t)));
+    }
+    counters.Stop();
+    counters.PrintPerOp(load_counters, load_count);
+    auto loaded = NowNanos();
+    counters.Start();
+    for (size_t i = load_count; i < num_ops; i++)
+    {
+        const uint64_t hash = BambooFilter::HashKey(&trace.keys[i], sizeof(uint64_t));
+        bool hit;
+        switch (trace.ops[i])
+        {
+        case kTraceInsert:
+            hit = bf->InsertHash(hash);
+            break;
+        case kTraceDelete:
+            hit = bf->DeleteHash(hash);
+            break;
+        case kTraceLookup:
+            hit = bf->LookupHash(hash);
+            break;
+        default:
+            // ReadTrace rejects these; count[] and hits[] are indexed by op
+            throw logic_error("Unknown trace op");
+        }
+        count[trace.ops[i]]++;
+        hits[trace.ops[i]] += hit;
+    }
+    counters.Stop();
+    counters.PrintPerOp(run_counters, num_ops - load_count);
+    auto finished = NowNanos();
+
+    if (!counters.Error().empty())
+    {
+        cout << "some counters unavailable (" << counters.Error() << ")" << endl;
+    }
+    cout << "phase\tops\tMops\t";
+    PerfCounters::PrintHeader(cout);
+    cout << endl;
+    cout << "load\t" << load_count << "\t" << (load_count * 1000.0) / static_cast<double>(loaded - start_time) << "\t"
+         << load_counters.str() << endl;
+    cout << "run\t" << (num_ops - load_count) << "\t"
+         << ((num_ops - load_count) * 1000.0) / static_cast<double>(finished - loaded) << "\t" << run_counters.str()
+         << endl;
+    cout << "  inserts " << count[kTraceInsert] << ", lookups " << count[kTraceLookup] << " (" << hits[kTraceLookup]
+         << " positive), deletes " << count[kTraceDelete] << " (" << hits[kTraceDelete] << " found)" << endl;
+    cout << "items " << bf->num_items_ << ", " << bf->SizeInBytes() * 8.0 / (bf->num_items_ ? bf->num_items_ : 1)
+         << " bits/key" << endl;
+
+    delete bf;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <string>
+#include <iostream>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/filter_server.hpp"
+#include "bamboofilter/bitsutil.h"
+
+using namespace std;
+
+static FilterServer *server = NULL;
+
+static void StopServer(int)
+{
+    server->Stop();
+}
+
+// Serves one BambooFilter on a Unix domain socket until SIGINT or SIGTERM:
+//   server [socket path] [capacity]
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "/tmp/bamboofilter.sock";
+    uint64_t capacity = argc > 2 ? strtoull(argv[2], NULL, 10) : 1 << 20;
+
+    server = new FilterServer(path, upperpower2(capacity), 2);
+    signal(SIGINT, StopServer);
+    signal(SIGTERM, StopServer);
+
+    cout << "serving on " << path << endl;
+    server->Run();
+    cout << server->NumRequests() << " requests in " << server->NumBatches() << " batches, "
+         << server->Filter().num_items_ << " items" << endl;
+
+    delete server;
+    return 0;
+}
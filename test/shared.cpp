@@ -0,0 +1,92 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bamboofilter/shared_bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// One writer process keeps inserting into a shared-memory filter (through
+// several Extend rounds) while forked reader processes map it read-only and
+// look up keys that were inserted before they started. Any miss is a false
+// negative and fails the run.
+int main(int argc, char *argv[])
+{
+    size_t add_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000 * 4;
+    int num_readers = argc > 2 ? atoi(argv[2]) : 4;
+    const char *name = "/bamboofilter_shared_test";
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    SharedBambooFilter *writer = new SharedBambooFilter(name, 256ULL << 20, upperpower2(add_count / 4), 2);
+    size_t preloaded = add_count / 4;
+    for (size_t i = 0; i < preloaded; i++)
+    {
+        writer->Insert(to_add[i].c_str());
+    }
+
+    vector<pid_t> readers;
+    for (int r = 0; r < num_readers; r++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            SharedBambooFilterReader reader(name);
+            uint64_t misses = 0, rounds = 4;
+            auto start_time = NowNanos();
+            for (uint64_t round = 0; round < rounds; round++)
+            {
+                for (size_t i = 0; i < preloaded; i++)
+                {
+                    misses += !reader.Lookup(to_add[i].c_str());
+                }
+            }
+            double mops = (rounds * preloaded * 1000.0) / static_cast<double>(NowNanos() - start_time);
+            printf("reader %d: %.3f Mops/s, %lu retries, %lu false negatives\n",
+                   r, mops, (unsigned long)reader.Retries(), (unsigned long)misses);
+            fflush(stdout);
+            _exit(misses ? 1 : 0);
+        }
+        readers.push_back(pid);
+    }
+
+    auto start_time = NowNanos();
+    for (size_t i = preloaded; i < add_count; i++)
+    {
+        writer->Insert(to_add[i].c_str());
+    }
+    cout << "writer: " << ((add_count - preloaded) * 1000.0) / static_cast<double>(NowNanos() - start_time)
+         << " Mops/s, arena " << (writer->ArenaUsed() >> 10) << " KiB" << endl;
+
+    int failed = 0;
+    for (pid_t pid : readers)
+    {
+        int status;
+        waitpid(pid, &status, 0);
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+    }
+
+    delete writer;
+    SharedBambooFilter::Unlink(name);
+
+    if (failed)
+    {
+        throw logic_error("False Negative");
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <string>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/timing.h"
+#include "common/workload.h"
+
+using namespace std;
+
+// Writes a workload trace for replay:
+//   tracegen <file> <keys> <ops> [uniform|zipf|hot] [insert ratio] [delete ratio]
+//            [negative ratio] [zipf theta | hot fraction] [seed]
+// The trace loads <keys> keys, then runs <ops> operations; lookups take what
+// inserts and deletes leave.
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        cerr << "usage: " << argv[0] << " file keys ops [uniform|zipf|hot] [insert] [delete] [negative] [theta|hot] [seed]"
+             << endl;
+        return 1;
+    }
+    const char *path = argv[1];
+    uint64_t num_keys = strtoull(argv[2], NULL, 10);
+    uint64_t num_ops = strtoull(argv[3], NULL, 10);
+
+    WorkloadSpec spec;
+    const char *distribution = argc > 4 ? argv[4] : "uniform";
+    if (!strcmp(distribution, "zipf"))
+    {
+        spec.distribution = kZipfianKeys;
+    }
+    else if (!strcmp(distribution, "hot"))
+    {
+        spec.distribution = kHotSetKeys;
+    }
+    else if (strcmp(distribution, "uniform"))
+    {
+        cerr << "unknown distribution " << distribution << endl;
+        return 1;
+    }
+    spec.insert_ratio = argc > 5 ? atof(argv[5]) : 0;
+    spec.delete_ratio = argc > 6 ? atof(argv[6]) : 0;
+    spec.negative_ratio = argc > 7 ? atof(argv[7]) : 0.5;
+    if (argc > 8)
+    {
+        (spec.distribution == kZipfianKeys ? spec.zipf_theta : spec.hot_fraction) = atof(argv[8]);
+    }
+    spec.seed = argc > 9 ? strtoull(argv[9], NULL, 10) : 1;
+
+    Trace trace;
+    auto start_time = NowNanos();
+    GenerateTrace(spec, num_keys, num_ops, trace);
+    auto generated = NowNanos();
+    WriteTrace(path, trace);
+    auto written = NowNanos();
+
+    cout << "generated " << trace.ops.size() << " ops in " << (generated - start_time) / 1e6 << " ms ("
+         << trace.ops.size() * 1000.0 / (generated - start_time) << " Mops), written in "
+         << (written - generated) / 1e6 << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <string>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bamboofilter/windowed_bamboofilter.hpp"
+#include "bamboofilter/bitsutil.h"
+
+#include "common/random.h"
+#include "common/timing.h"
+
+using namespace std;
+
+// Stream dedup over a window of 4 generations: the stream is cut into chunks,
+// one chunk per generation. After each Advance, every chunk still inside the
+// window must be found, and the chunk that just expired should only show up
+// at the false positive rate. Then a timer drives the advances while this
+// thread keeps looking up, until the last chunk has expired too.
+int main(int argc, char *argv[])
+{
+    const uint32_t num_generations = 4;
+    size_t chunk = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+    size_t num_chunks = 10;
+    size_t add_count = chunk * num_chunks;
+
+    cout << "Prepare..." << endl;
+
+    vector<string> to_add, to_lookup;
+    GenerateRandom64(add_count, to_add, to_lookup);
+
+    cout << "Begin test" << endl;
+
+    WindowedBambooFilter *wbf = new WindowedBambooFilter(num_generations, upperpower2(chunk), 2);
+
+    auto start_time = NowNanos();
+    uint64_t lookups = 0;
+    for (size_t c = 0; c < num_chunks; c++)
+    {
+        for (size_t i = c * chunk; i < (c + 1) * chunk; i++)
+        {
+            wbf->Insert(to_add[i].c_str());
+        }
+        for (size_t live = c + 1 >= num_generations ? c + 1 - num_generations : 0; live <= c; live++)
+        {
+            for (size_t i = live * chunk; i < (live + 1) * chunk; i++)
+            {
+                if (!wbf->Lookup(to_add[i].c_str()))
+                {
+                    throw logic_error("False Negative");
+                }
+            }
+            lookups += chunk;
+        }
+        if (c >= num_generations)
+        {
+            size_t expired = c - num_generations, found = 0;
+            for (size_t i = expired * chunk; i < (expired + 1) * chunk; i++)
+            {
+                found += wbf->Lookup(to_add[i].c_str());
+            }
+            cout << "chunk " << expired << " expired, still reported: " << (found * 1.0 / chunk) << endl;
+        }
+        wbf->Advance();
+    }
+    cout << "insert+lookup: " << ((add_count + lookups) * 1000.0) / static_cast<double>(NowNanos() - start_time) << endl;
+
+    // timer-driven expiry: the last chunk sits one generation behind the
+    // newest, so num_generations - 1 ticks retire it; until then it must stay
+    // visible to lookups running alongside the timer thread
+    const uint64_t start_generation = wbf->Generation();
+    const size_t last = add_count - chunk;
+    wbf->StartExpiry(20);
+    for (int waited_ms = 0; wbf->Generation() < start_generation + num_generations - 1; waited_ms++)
+    {
+        if (waited_ms > 10000)
+        {
+            throw logic_error("Timer expiry did not advance the window");
+        }
+        const uint64_t generation = wbf->Generation();
+        const bool found = wbf->Lookup(to_add[last + waited_ms % chunk].c_str());
+        if (!found && wbf->Generation() == generation && generation < start_generation + num_generations - 1)
+        {
+            throw logic_error("False Negative");
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    wbf->StopExpiry();
+    size_t found = 0;
+    for (size_t i = last; i < add_count; i++)
+    {
+        found += wbf->Lookup(to_add[i].c_str());
+    }
+    cout << "after timer expiry (generation " << wbf->Generation() << "), still reported: " << (found * 1.0 / chunk) << endl;
+    if (found * 10 > chunk)
+    {
+        throw logic_error("Timer expiry left the expired chunk in place");
+    }
+
+    delete wbf;
+    return 0;
+}